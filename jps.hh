@@ -56,6 +56,15 @@ struct MyGrid
     unsigned width, height;
 };
 
+// Optionally, your grid class may also provide 64 cells of a row at once:
+//   JPS::BitWord getRowBits(unsigned x, unsigned y, int dir) const;
+// Bit i of the result must be set if the cell at (x + i*dir, y) is walkable, with dir being 1 or -1.
+// The Searcher detects this method at compile time and uses it to scan 63 cells per step in horizontal jumps.
+// Likewise for columns and vertical jumps, with bit i being the cell at (x, y + i*dir):
+//   JPS::BitWord getColBits(unsigned x, unsigned y, int dir) const;
+// (For a row-major grid, getColBits() is only worth it if you keep a transposed copy of your map.)
+// JPS::BitGrid has this already; see below.
+
 // Then you can retrieve a path:
 
 MyGrid grid(... set grid width, height, map data, whatever);
@@ -87,6 +96,48 @@ bool found = JPS::findPath(path, grid, startx, starty, endx, endy, step);
 // forwarded to your own JPS_realloc & JPS_free if you've set those. Otherwise it's ignored.
 JPS::Searcher<MyGrid> search(grid, userPtr = NULL);
 
+// If your grid has fixed, known dimensions, a dense node map is faster than the default hash map,
+// but it needs 8 bytes per grid cell:
+JPS::Searcher<MyGrid, JPS::DenseNodeMap> search(grid, userPtr = NULL);
+search.getNodeMap().init(width, height);
+
+// With integer scores (the default), a bucket queue is faster than the default binary heap as open list:
+JPS::Searcher<MyGrid, JPS::NodeMap, JPS::BucketOpenList> search(grid, userPtr = NULL);
+
+// For very large grids: Hierarchical search over clusters, with slightly longer paths. See JPS::HierSearcher.
+JPS::HierSearcher<MyGrid> hsearch(grid, userPtr = NULL);
+hsearch.init(width, height, clusterSize = 32); // precompute; call hsearch.update(x, y) whenever a cell changes
+
+// For a unit that follows its path while the grid changes: JPS::ReplanSearcher repairs the path instead of starting over.
+JPS::ReplanSearcher<MyGrid> rsearch(grid, userPtr = NULL);
+rsearch.findPath(path, start, end, step); // then rsearch.moveStart(p) as the unit moves, rsearch.notifyCellChanged(x, y) after a change
+
+// Many agents asking for the same paths: Put a JPS::PathCache in front of any searcher.
+JPS::PathCache<JPS::Searcher<MyGrid> > cache(search, userPtr = NULL);
+cache.init(width, height, regionSize = 16, maxBytes = 1 << 20); // call cache.update(x, y) whenever a cell changes
+cache.findPath(path, start, end, step); // same as search.findPath(), but cached
+
+// Hundreds of agents heading to the same goal: Build a flow field once, then agents just follow it.
+JPS::FlowField<MyGrid> flow(grid, userPtr = NULL);
+flow.build(goal, dist, dir, x0, y0, w, h); // fills dist[w*h] and dir[w*h]; next cell: JPS::FlowField<MyGrid>::getStep(pos, dir[...])
+
+// Costs, A* vs. JPS and diagonal movement can be fixed at compile time via a policy, e.g. plain A* without cutting corners:
+typedef JPS::SearchPolicy<JPS::Heuristic::OctileCosts, JPS::Expand_AStar, JPS::Diagonal_NoCornerCutting> MyPolicy;
+JPS::Searcher<MyGrid, JPS::NodeMap, JPS::OpenList, MyPolicy> search(grid, userPtr = NULL);
+
+// Trade path length for speed: Paths found are at most 20% longer than the shortest one (needs an admissible estimate,
+// e.g. JPS::Heuristic::OctileCosts). Add search.setAnytime(10) to improve the path with further findPathStep() calls.
+search.setWeight(120);
+
+// Path to the closest of many goals, with a single search:
+JPS::Position goals[200] = <...>;
+search.findPathToNearest(path, start, goals, 200, step); // path ends at the goal that was reached
+
+// Costs to many targets, with a single search:
+JPS::ScoreType costs[200];
+search.findCostsToMany(start, goals, 200, costs); // costs[i] is JPS::noscore if goals[i] can't be reached
+search.findPathFinishTo(path, goals[i], step); // optionally, the path to one of them
+
 // build path incrementally from waypoints:
 JPS::Position a, b, c, d = <...>; // set some waypoints
 if (search.findPath(path, a, b)
@@ -176,11 +227,24 @@ Aborting or starting a search resets the values returned by .getStepsDone() and
 // Turns out in some testing this was ~12% faster, so it's the default.
 #define JPS_NO_FLOAT
 
+// By default, JPS_NO_FLOAT counts a diagonal step like a straight one, and the estimate can overestimate,
+// so paths are not always the shortest. Define this to use exact octile distances in fixed point instead
+// (straight step = 1000, diagonal step = 1414) for both costs and estimate: Still integer-only, and the paths are optimal.
+// But the search is less greedy than with the default estimate, so it may expand a lot more nodes on open maps.
+// Limit: ScoreType is still int, so path costs must stay below 2^31, i.e. paths can't be longer than about
+// 2.1 million straight steps (ReplanSearcher: 1 million), including winding detours. The same goes for
+// Heuristic::OctileCosts. Weighted search (Searcher::setWeight()) lowers this limit further.
+//#define JPS_OCTILE
+
 
 // ------------------------------------------------
 
 #include <stddef.h> // for size_t (needed for operator new)
 
+#if defined(_MSC_VER) && defined(_M_X64)
+# include <intrin.h> // for _BitScanForward64
+#endif
+
 // Assertions
 #ifndef JPS_ASSERT
 # ifdef _DEBUG
@@ -204,7 +268,12 @@ Aborting or starting a search resets the values returned by .getStepsDone() and
 #endif
 
 #ifdef JPS_NO_FLOAT
-#define JPS_HEURISTIC_ACCURATE(a, b) (Heuristic::Chebyshev(a, b))
+# ifdef JPS_OCTILE
+#  define JPS_HEURISTIC_ACCURATE(a, b) (Heuristic::Octile(a, b))
+#  define JPS_HEURISTIC_ESTIMATE(a, b) (Heuristic::Octile(a, b))
+# else
+#  define JPS_HEURISTIC_ACCURATE(a, b) (Heuristic::Chebyshev(a, b))
+# endif
 #else
 # ifndef JPS_sqrt
 // for Euclidean heuristic.
@@ -247,6 +316,17 @@ typedef float ScoreType;
 // Size type; used internally for vectors and the like. You can set this to size_t if you want, but 32 bits is more than enough.
 typedef unsigned SizeT;
 
+// 64 bit unsigned integer type. Used by BitGrid.
+// (long long is not C++98, but every compiler has it; keep GCC and clang quiet about that with -pedantic.)
+#ifdef __GNUC__
+#  pragma GCC diagnostic push
+#  pragma GCC diagnostic ignored "-Wlong-long"
+#endif
+typedef unsigned long long BitWord;
+#ifdef __GNUC__
+#  pragma GCC diagnostic pop
+#endif
+
 } // end namespace JPS
 
 
@@ -274,6 +354,7 @@ enum JPS_Flags_
     // is slow (aka worse than O(1) or more than a few inlined instructions),
     // as it avoids the large area scans that the JPS algorithm does.
     // (Also increases memory usage as each checked position is expanded into a node.)
+    // Only used by Searchers with the default policy (Expand_Flags), see SearchPolicy.
     JPS_Flag_AStarOnly     = 0x02,
 
     // Don't check whether start position is walkable.
@@ -325,6 +406,7 @@ struct Position
 // The invalid position. Used internally to mark non-walkable points.
 static const Position npos = {PosType(-1), PosType(-1)};
 static const SizeT noidx = SizeT(-1);
+static const ScoreType noscore = ScoreType(-1); // costs are never negative
 
 // ctor function to keep Position a real POD struct.
 inline static Position Pos(PosType x, PosType y)
@@ -357,6 +439,16 @@ namespace Heuristic
         const int dy = Abs(int(a.y - b.y));
         return static_cast<ScoreType>(Max(dx, dy));
     }
+
+    // Octile distance in fixed point: 1000 per straight step, 1414 per diagonal step.
+    // Exact for any two positions without obstacles in between, so it never overestimates.
+    // With integer scores, sums of these overflow after about 2.1 million straight steps; see JPS_OCTILE.
+    inline ScoreType Octile(const Position& a, const Position& b)
+    {
+        const int dx = Abs(int(a.x - b.x));
+        const int dy = Abs(int(a.y - b.y));
+        return static_cast<ScoreType>(1000 * Max(dx, dy) + 414 * Min(dx, dy));
+    }
 #ifdef JPS_sqrt
     inline ScoreType Euclidean(const Position& a, const Position& b)
     {
@@ -365,8 +457,72 @@ namespace Heuristic
         return static_cast<ScoreType>(JPS_sqrt(dx*dx + dy*dy));
     }
 #endif
+
+    // Cost models for SearchPolicy.
+    // Cost() is the exact cost of moving along a straight or diagonal line, Estimate() guesses the remaining distance to the end.
+
+    // As configured via JPS_HEURISTIC_ACCURATE and JPS_HEURISTIC_ESTIMATE
+    struct DefaultCosts
+    {
+        static inline ScoreType Cost(const Position& a, const Position& b) { return JPS_HEURISTIC_ACCURATE(a, b); }
+        static inline ScoreType Estimate(const Position& a, const Position& b) { return JPS_HEURISTIC_ESTIMATE(a, b); }
+    };
+
+    // Exact and optimal, in fixed point. Same as JPS_OCTILE, but independent of the compile config.
+    struct OctileCosts
+    {
+        static inline ScoreType Cost(const Position& a, const Position& b) { return Octile(a, b); }
+        static inline ScoreType Estimate(const Position& a, const Position& b) { return Octile(a, b); }
+    };
+
+    // For Diagonal_Never
+    struct ManhattanCosts
+    {
+        static inline ScoreType Cost(const Position& a, const Position& b) { return Manhattan(a, b); }
+        static inline ScoreType Estimate(const Position& a, const Position& b) { return Manhattan(a, b); }
+    };
+
+    // Same costs, but no estimate: Turns A* into Dijkstra's algorithm, for searches that don't have a single end.
+    template<typename COSTS>
+    struct NoEstimate
+    {
+        static inline ScoreType Cost(const Position& a, const Position& b) { return COSTS::Cost(a, b); }
+        static inline ScoreType Estimate(const Position&, const Position&) { return 0; }
+    };
 } // end namespace heuristic
 
+// How the Searcher finds neighbors of a node
+enum Expansion
+{
+    Expand_Flags, // JPS, or A* if JPS_Flag_AStarOnly is passed. Checked once per node.
+    Expand_JPS,   // Always JPS, ignores JPS_Flag_AStarOnly
+    Expand_AStar  // Always plain A*, ignores JPS_Flag_AStarOnly
+};
+
+// When a diagonal step from (x, y) to (x+dx, y+dy) is allowed
+enum DiagonalRule
+{
+    Diagonal_NoTunneling,     // (x+dx, y) or (x, y+dy) is walkable; may cut one corner but not squeeze through two.
+    Diagonal_NoCornerCutting, // (x+dx, y) and (x, y+dy) are walkable. A* only.
+    Diagonal_Never            // Only straight steps. A* only; use with Heuristic::ManhattanCosts.
+};
+
+// Compile-time search configuration; pass as 4th template parameter to Searcher.
+// Each combination is a separate Searcher type with its own specialized inner loop,
+// so any number of differently configured searchers can be used side by side.
+// JPS (and JumpTable, GoalBounds) rely on Diagonal_NoTunneling.
+// All diagonal rules connect the same cells, so a ComponentMap works with any of them.
+template<typename COSTS = Heuristic::DefaultCosts, Expansion EXPANSION = Expand_Flags, DiagonalRule DIAGONAL = Diagonal_NoTunneling>
+struct SearchPolicy
+{
+    typedef COSTS Costs;
+    static const Expansion expansion = EXPANSION;
+    static const DiagonalRule diagonal = DIAGONAL;
+
+    // Compile error here? JPS expansion requires the default diagonal rule.
+    typedef char JPS_needs_Diagonal_NoTunneling[(EXPANSION == Expand_AStar || DIAGONAL == Diagonal_NoTunneling) ? 1 : -1];
+};
+
 
 
 // --- Begin infrastructure, data structures ---
@@ -380,12 +536,21 @@ struct Node
     Position pos;
     int parentOffs; // no parent if 0
     unsigned _flags;
+    SizeT _heapIdx; // position in the open list heap; only valid while open
 
     inline int hasParent() const { return parentOffs; }
     inline void setOpen() { _flags |= 1; }
     inline void setClosed() { _flags |= 2; }
-    inline unsigned isOpen() const { return _flags & 1; }
+    inline void clearOpen() { _flags &= ~1u; }
+    inline unsigned isOpen() const { return _flags & 1; } // was reached, so g is valid
     inline unsigned isClosed() const { return _flags & 2; }
+    // Anytime search only:
+    inline unsigned isIncons() const { return _flags & 4; } // g improved after it was closed
+    inline unsigned isIdle() const { return _flags & 8; } // was reached but is neither in the open list nor closed
+    inline void setIncons() { _flags |= 4; }
+    inline void setIdle() { _flags = (_flags & ~(2u | 4u)) | 8u; }
+    inline void clearIdle() { _flags &= ~8u; }
+    inline void reopen() { _flags &= ~(2u | 4u | 8u); } // neither closed nor idle, and consistent again
 
     // We know nodes are allocated sequentially in memory, so this is fine.
     inline       Node& getParent()       { JPS_ASSERT(parentOffs); return this[parentOffs]; }
@@ -455,6 +620,14 @@ public:
         return cap * sizeof(T);
     }
 
+    void swap(PodVec<T>& o) // both must use the same user pointer
+    {
+        JPS_ASSERT(_user == o._user);
+        T * const d = _data; _data = o._data; o._data = d;
+        const SizeT u = used; used = o.used; o.used = u;
+        const SizeT c = cap; cap = o.cap; o.cap = c;
+    }
+
     // minimal iterator interface
     typedef T* iterator;
     typedef const T* const_iterator;
@@ -511,177 +684,396 @@ inline static void Reverse(IT first, IT last)
     }
 }
 
+// Index of the lowest set bit. x must not be 0.
+inline static unsigned BitScan(BitWord x)
+{
+    JPS_ASSERT(x);
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(x);
+#elif defined(_MSC_VER) && defined(_M_X64)
+    unsigned long r;
+    _BitScanForward64(&r, x);
+    return r;
+#else
+    unsigned n = 0;
+    for( ; !(x & 1); x >>= 1)
+        ++n;
+    return n;
+#endif
+}
+
+// 32 bit pattern in both halves; avoids 64 bit literals, which C++98 doesn't have
+inline static BitWord Pattern64(unsigned x)
+{
+    return (BitWord(x) << 32) | x;
+}
+
+inline static BitWord ReverseBits(BitWord x)
+{
+    x = ((x >> 1) & Pattern64(0x55555555u)) | ((x & Pattern64(0x55555555u)) << 1);
+    x = ((x >> 2) & Pattern64(0x33333333u)) | ((x & Pattern64(0x33333333u)) << 2);
+    x = ((x >> 4) & Pattern64(0x0f0f0f0fu)) | ((x & Pattern64(0x0f0f0f0fu)) << 4);
+    x = ((x >> 8) & Pattern64(0x00ff00ffu)) | ((x & Pattern64(0x00ff00ffu)) << 8);
+    x = ((x >> 16) & Pattern64(0x0000ffffu)) | ((x & Pattern64(0x0000ffffu)) << 16);
+    return (x >> 32) | (x << 32);
+}
+
+template<bool> struct BoolConst {};
+
+// value is true if GRID has a BitWord getRowBits(PosType x, PosType y, int dir) const method
+template<typename GRID> struct HasRowBits
+{
+    typedef char Yes;
+    typedef char No[2];
+    template<typename U, BitWord (U::*)(PosType, PosType, int) const> struct Check {};
+    template<typename U> static Yes& test(Check<U, &U::getRowBits>*);
+    template<typename U> static No& test(...);
+    enum { value = sizeof(test<GRID>(0)) == sizeof(Yes) };
+};
+
+// Same for BitWord getColBits(PosType x, PosType y, int dir) const
+template<typename GRID> struct HasColBits
+{
+    typedef char Yes;
+    typedef char No[2];
+    template<typename U, BitWord (U::*)(PosType, PosType, int) const> struct Check {};
+    template<typename U> static Yes& test(Check<U, &U::getColBits>*);
+    template<typename U> static No& test(...);
+    enum { value = sizeof(test<GRID>(0)) == sizeof(Yes) };
+};
+
+// For block-based straight jumps. Bit i of each input is the cell i steps ahead;
+// side1 and side2 are the lines left and right of the jump line, mid is the jump line itself.
+// Looks for the first jump point (blocked to the side here, free to the side on the next cell = forced neighbor; or the end position)
+// or the first cell that is followed by an obstacle. Deciding about a cell needs a look at the next one,
+// so only the lower 63 bits can be decided. Returns 63 if none of them is interesting,
+// otherwise the offset of the first one, and whether that is a jump point.
+inline static unsigned ScanBlock(BitWord side1, BitWord mid, BitWord side2, unsigned endIdx, bool& isJP)
+{
+    BitWord stop = (~side1 & (side1 >> 1)) | (~side2 & (side2 >> 1));
+    if(endIdx < 63)
+        stop |= BitWord(1) << endIdx;
+    const BitWord blocked = ~mid >> 1; // next cell is not walkable
+    const BitWord any = (stop | blocked) & (~BitWord(0) >> 1);
+    if(!any)
+        return 63;
+    const unsigned i = BitScan(any);
+    isJP = !!(stop & (BitWord(1) << i)); // jump point takes precedence
+    return i;
+}
+
 typedef PodVec<Node> Storage;
 
+// Append a fresh node for (x, y) to the storage. Returns NULL if out of memory.
+inline static Node *NewNode(Storage& storage, PosType x, PosType y)
+{
+    Node *n = storage.alloc();
+    if(n)
+    {
+        n->f = 0;
+        n->g = 0;
+        n->pos.x = x;
+        n->pos.y = y;
+        n->parentOffs = 0;
+        n->_flags = 0;
+        n->_heapIdx = noidx;
+    }
+    return n;
+}
+
 
+// Hash map from position to node index. Open addressing with linear probing.
+// Growing is incremental: The previous table is kept around after a resize
+// and its entries are moved over a few at a time on each insert, so no single lookup has to rehash everything.
 class NodeMap
 {
 private:
-    static const unsigned LOAD_FACTOR = 8; // estimate: {CPU cache line size (64)} / sizeof(HashLoc)
-    static const unsigned INITIAL_BUCKETS = 16; // must be > 1 and power of 2
+    static const SizeT INITIAL_SLOTS = 64; // must be power of 2
+    static const SizeT MIGRATE_STEPS = 4; // old slots to move per insert while growing. Must be > 2 to finish before the next resize
 
-    struct HashLoc
+    struct Slot
     {
-        unsigned hash2; // for early-out check only
-        SizeT idx; // index in central storage
+        Position pos;
+        SizeT idx; // index in central storage; noidx if empty
     };
-    typedef PodVec<HashLoc> Bucket;
+    typedef PodVec<Slot> Table;
 
-    // hash function to determine bucket. only uses lower few bits. should jumble lower bits nicely.
+    // Mixes all bits of both coordinates into the lower bits (MurmurHash3 finalizer)
     static inline unsigned Hash(PosType x, PosType y)
     {
-        return x ^ y;
+        unsigned h = unsigned(x) * 0x9e3779b1u + unsigned(y);
+        h ^= h >> 16;
+        h *= 0x85ebca6bu;
+        h ^= h >> 13;
+        h *= 0xc2b2ae35u;
+        h ^= h >> 16;
+        return h;
+    }
+
+    // Returns the slot that holds (x, y), or the empty slot where it would go. The table must not be full.
+    static inline Slot& Probe(const Table& t, PosType x, PosType y, unsigned h)
+    {
+        const SizeT mask = t.size() - 1; // known to be power of 2
+        for(SizeT i = h & mask; ; i = (i + 1) & mask)
+        {
+            Slot& s = t[i];
+            if(s.idx == noidx || (s.pos.x == x && s.pos.y == y))
+                return s;
+        }
     }
 
-    // hash function designed to lose as little data as possible. for early-out checks. all bits used.
-    static inline unsigned Hash2(PosType x, PosType y)
+    static void MakeEmpty(Table& t)
     {
-        return (y << 16) ^ x;
+        for(Slot *s = t.begin(); s != t.end(); ++s)
+            s->idx = noidx;
     }
 
 public:
 
     NodeMap(Storage& storage)
-        : _storageRef(storage), _buckets(storage._user)
+        : _storageRef(storage), _tab(storage._user), _old(storage._user), _migratePos(0), _count(0)
     {}
 
-    ~NodeMap()
-    {
-        dealloc();
-    }
-
     void dealloc()
     {
-        for(SizeT i = 0; i < _buckets.size(); ++i)
-            _buckets[i].~Bucket();
-        _buckets.dealloc();
+        _tab.dealloc();
+        _old.dealloc();
+        _migratePos = 0;
+        _count = 0;
     }
     void clear()
     {
-        // clear the buckets, but *not* the bucket vector
-        for(SizeT i = 0; i <  _buckets.size(); ++i)
-            _buckets[i].clear();
+        // keep the table size, but drop any leftovers from growing
+        MakeEmpty(_tab);
+        _old.dealloc();
+        _migratePos = 0;
+        _count = 0;
     }
 
     Node *operator()(PosType x, PosType y)
     {
         const unsigned h = Hash(x, y);
-        const unsigned h2 = Hash2(x, y);
-        const SizeT ksz = _buckets.size(); // known to be power-of-2
-        Bucket *b = 0; // MSVC /W4 complains that this was uninitialized and used, so we init it...
-        if (ksz)
-        {
-            b = &_buckets[h & (ksz - 1)];
-            const SizeT bsz = b->size();
-            const HashLoc * const bdata = b->data();
-            for (SizeT i = 0; i < bsz; ++i)
-            {
-                // this is the only place where HashLoc::hash2 is used; it *could*be removed, which means:
-                // - twice as much space for indexes per cache line
-                // - but also higher chances for a cache miss because for each entry in the bucket we still need to check the node's X/Y coords,
-                //   and we'll likely end up in a random location in RAM for each node.
-                // Quick benchmarking showed that *with* the hash2 check it's almost immeasurably (less than 1%) faster.
-                if (bdata[i].hash2 == h2)
-                {
-                    Node &n = _storageRef[bdata[i].idx];
-                    if(n.pos.x == x && n.pos.y == y)
-                        return &n;
-                }
-            }
+        if(!_tab.empty())
+        {
+            const Slot& s = Probe(_tab, x, y, h);
+            if(s.idx != noidx)
+                return &_storageRef[s.idx];
+        }
+        if(!_old.empty())
+        {
+            const Slot& s = Probe(_old, x, y, h);
+            if(s.idx != noidx)
+                return &_storageRef[s.idx]; // not migrated yet; that'll happen eventually
         }
 
-        // enlarge hashmap if necessary; fix bucket if so
-        SizeT newbsz = _enlarge();
-        if(newbsz > 1)
-            b = &_buckets[h & (newbsz - 1)];
-        else if(newbsz == 1) // error case
+        // no node at (x, y), create new one
+        if(!_makeRoom())
             return 0;
-
-        HashLoc *loc = b->alloc(); // ... see above. b is always initialized here. when ksz==0, _enlarge() will do its initial allocation, so it can never return 0.
-
-        if(!loc)
+        Node *n = NewNode(_storageRef, x, y);
+        if(!n)
             return 0;
+        Slot& s = Probe(_tab, x, y, h);
+        s.pos = n->pos;
+        s.idx = _storageRef.getindex(n);
+        ++_count;
+        _migrate(MIGRATE_STEPS);
+        return n;
+    }
 
-        loc->hash2 = h2;
-        loc->idx = _storageRef.size();
-
-        // no node at (x, y), create new one
-        Node *n = _storageRef.alloc();
-        if(n)
+    // Existing node at (x, y) or NULL; never creates one
+    const Node *find(PosType x, PosType y) const
+    {
+        const unsigned h = Hash(x, y);
+        if(!_tab.empty())
         {
-            n->f = 0;
-            n->g = 0;
-            n->pos.x = x;
-            n->pos.y = y;
-            n->parentOffs = 0;
-            n->_flags = 0;
+            const Slot& s = Probe(_tab, x, y, h);
+            if(s.idx != noidx)
+                return &_storageRef[s.idx];
         }
-        return n;
+        if(!_old.empty())
+        {
+            const Slot& s = Probe(_old, x, y, h);
+            if(s.idx != noidx)
+                return &_storageRef[s.idx];
+        }
+        return 0;
     }
 
     SizeT _getMemSize() const
     {
-        SizeT sum = _buckets._getMemSize();
-        for(Buckets::const_iterator it = _buckets.cbegin(); it != _buckets.cend(); ++it)
-            sum += it->_getMemSize();
-        return sum;
+        return _tab._getMemSize() + _old._getMemSize();
     }
 
 private:
 
-    // return values: 0 = nothing to do; 1 = error; >1: internal storage was enlarged to this many buckets
-    SizeT _enlarge()
+    // Make sure there is space for one more entry; keep load factor <= 1/2. Returns false if out of memory.
+    bool _makeRoom()
     {
-        const SizeT n = _storageRef.size();
-        const SizeT oldsz = _buckets.size();
-        if (n < oldsz * LOAD_FACTOR)
-            return 0;
+        const SizeT cap = _tab.size();
+        if((_count + 1) * 2 <= cap)
+            return true;
+
+        _migrate(_old.size()); // Finish previous growing step, if any. Rarely happens.
+        _old.swap(_tab);
+        _tab.resize(cap ? cap * 2 : INITIAL_SLOTS); // stays power of 2
+        if(_tab.size() <= cap) // out of memory
+        {
+            _tab.swap(_old);
+            _old.dealloc();
+            return _count + 1 < cap; // Still one free slot? Then it's a bit slower but fine.
+        }
+        MakeEmpty(_tab);
+        _migratePos = 0;
+        return true;
+    }
+
+    // Move up to n slots from the old table into the current one
+    void _migrate(SizeT n)
+    {
+        const SizeT end = Min(_old.size(), _migratePos + n);
+        for( ; _migratePos < end; ++_migratePos)
+        {
+            const Slot& o = _old[_migratePos];
+            if(o.idx != noidx)
+                Probe(_tab, o.pos.x, o.pos.y, Hash(o.pos.x, o.pos.y)) = o;
+        }
+        if(_migratePos && _migratePos == _old.size())
+        {
+            _old.dealloc();
+            _migratePos = 0;
+        }
+    }
+
+    Storage& _storageRef;
+    Table _tab; // New entries go here
+    Table _old; // Previous table while growing, empty otherwise. Entries before _migratePos are also in _tab.
+    SizeT _migratePos;
+    SizeT _count;
+};
+
+// Alternative to NodeMap for grids with known, fixed dimensions.
+// Keeps one entry per grid cell, so finding the node for a position is a single indexed load,
+// at the cost of 8 bytes per cell (allocated on first use).
+// Entries are tagged with a generation number, so clearing between searches is O(1).
+// Usage: JPS::Searcher<MyGrid, JPS::DenseNodeMap> search(grid);
+//        search.getNodeMap().init(width, height);
+// Positions outside of the given dimensions are not supported.
+// With setOrigin(), it covers a window of a larger grid; searches must then stay inside of that window.
+class DenseNodeMap
+{
+private:
+    struct Cell
+    {
+        SizeT idx; // index in central storage
+        unsigned gen; // entry is only valid if this matches _gen
+    };
+
+public:
 
-        // pre-allocate bucket storage that we're going to use
-        const SizeT newsz = oldsz ? oldsz * 2 : INITIAL_BUCKETS; // stays power of 2
+    DenseNodeMap(Storage& storage)
+        : _storageRef(storage), _cells(storage._user), _w(0), _h(0), _x0(0), _y0(0), _gen(1)
+    {}
 
-        if(!_buckets._reserve(newsz))
-            return 0; // early out if realloc fails; this not a problem and we can continue.
+    // Set grid dimensions. Drops all entries.
+    void init(PosType w, PosType h)
+    {
+        dealloc();
+        _w = w;
+        _h = h;
+    }
 
-        // forget everything
-        for(SizeT i = 0; i < oldsz; ++i)
-            _buckets[i].clear();
+    // Position of the top left cell. Only change this between searches.
+    inline void setOrigin(PosType x, PosType y)
+    {
+        _x0 = x;
+        _y0 = y;
+    }
 
-        // resize and init
-        for(SizeT i = oldsz; i < newsz; ++i)
+    void dealloc()
+    {
+        _cells.dealloc();
+        _gen = 1;
+    }
+    void clear()
+    {
+        if(!++_gen) // wrapped around? then old entries may look valid again
         {
-            void *p = _buckets.alloc(); // can't fail since the space was reserved
-            JPS_PLACEMENT_NEW(p) PodVec<HashLoc>(_buckets._user);
+            _invalidateAll();
+            _gen = 1;
         }
+    }
 
-        const SizeT mask = _buckets.size() - 1;
-        for(SizeT i = 0; i < n; ++i)
-        {
-            const Position p = _storageRef[i].pos;
-            HashLoc *loc = _buckets[Hash(p.x, p.y) & mask].alloc();
-            if(!loc)
-                return 1; // error case
+    Node *operator()(PosType x, PosType y)
+    {
+        JPS_ASSERT(x - _x0 < _w && y - _y0 < _h);
+        if(_cells.empty() && !_alloc())
+            return 0;
 
-            loc->hash2 = Hash2(p.x, p.y);
-            loc->idx = i;
+        Cell& c = _cells[size_t(y - _y0) * _w + (x - _x0)];
+        if(c.gen == _gen)
+            return &_storageRef[c.idx];
+
+        Node *n = NewNode(_storageRef, x, y);
+        if(n)
+        {
+            c.idx = _storageRef.getindex(n);
+            c.gen = _gen;
         }
-        return newsz;
+        return n;
+    }
+
+    // Existing node at (x, y) or NULL; never creates one
+    const Node *find(PosType x, PosType y) const
+    {
+        x -= _x0;
+        y -= _y0;
+        if(x >= _w || y >= _h || _cells.empty())
+            return 0;
+        const Cell& c = _cells[size_t(y) * _w + x];
+        return c.gen == _gen ? &_storageRef[c.idx] : 0;
+    }
+
+    inline SizeT _getMemSize() const
+    {
+        return _cells._getMemSize();
+    }
+
+private:
+
+    bool _alloc()
+    {
+        const SizeT n = _w * _h;
+        if(!n)
+            return false; // init() wasn't called
+        _cells.resize(n);
+        if(_cells.size() != n)
+            return false;
+        _invalidateAll();
+        return true;
+    }
+
+    void _invalidateAll()
+    {
+        for(Cell *c = _cells.begin(); c != _cells.end(); ++c)
+            c->gen = 0; // _gen is never 0
     }
 
     Storage& _storageRef;
-    typedef PodVec<Bucket> Buckets;
-    Buckets _buckets;
+    PodVec<Cell> _cells;
+    PosType _w, _h;
+    PosType _x0, _y0;
+    unsigned _gen;
 };
 
 class OpenList
 {
 private:
-    const Storage& _storageRef;
+    Storage& _storageRef;
     PodVec<SizeT> idxHeap;
 
 public:
 
-    OpenList(const Storage& storage)
+    OpenList(Storage& storage)
         : _storageRef(storage), idxHeap(storage._user)
     {}
 
@@ -699,16 +1091,8 @@ public:
     // re-heapify after node changed its order
     inline void fixNode(const Node& n)
     {
-        const unsigned ni = _storageRef.getindex(&n);
-        const unsigned sz = idxHeap.size();
-        unsigned *p = idxHeap.data();
-        for(unsigned i = 0; i < sz; ++i) // TODO: if this ever becomes a perf bottleneck: make it so that each node knows its heap index
-            if(p[i] == ni)
-            {
-                _fixIdx(i);
-                return;
-            }
-            JPS_ASSERT(false); // expect node to be found
+        JPS_ASSERT(n._heapIdx < idxHeap.size() && idxHeap[n._heapIdx] == _storageRef.getindex(&n)); // expect node to be in the heap
+        _fixIdx(n._heapIdx);
     }
 
     inline void dealloc() { idxHeap.dealloc(); }
@@ -732,6 +1116,13 @@ private:
         return _storageRef[idxHeap[a]].f > _storageRef[idx].f;
     }
 
+    // put node idx at heap position i and let the node know where it is
+    inline void _place(SizeT i, SizeT idx)
+    {
+        idxHeap[i] = idx;
+        _storageRef[idx]._heapIdx = i;
+    }
+
     void _percolateUp(SizeT i)
     {
         const SizeT idx = idxHeap[i];
@@ -739,13 +1130,13 @@ private:
         goto start;
         do
         {
-            idxHeap[i] = idxHeap[p]; // parent is smaller, move it down
-            i = p;                   // continue with parent
+            _place(i, idxHeap[p]); // parent is smaller, move it down
+            i = p;                 // continue with parent
 start:
             p = (i - 1) >> 1;
         }
         while(i && _heapLessIdx(p, idx));
-        idxHeap[i] = idx; // found correct place for idx
+        _place(i, idx); // found correct place for idx
     }
 
     void _percolateDown(SizeT i)
@@ -759,13 +1150,13 @@ start:
             // pick right sibling if exists and larger or equal
             if(child + 1 < sz && !_heapLess(child+1, child))
                 ++child;
-            idxHeap[i] = idxHeap[child];
+            _place(i, idxHeap[child]);
             i = child;
 start:
             child = (i << 1) + 1;
         }
         while(child < sz);
-        idxHeap[i] = idx;
+        _place(i, idx);
         _percolateUp(i);
     }
 
@@ -781,7 +1172,7 @@ start:
         SizeT sz = idxHeap.size();
         JPS_ASSERT(sz);
         const SizeT root = idxHeap[0];
-        idxHeap[0] = idxHeap[--sz];
+        _place(0, idxHeap[--sz]);
         idxHeap.pop_back();
         if(sz > 1)
             _percolateDown(0);
@@ -796,654 +1187,3843 @@ start:
     }
 };
 
-#undef JPS_PLACEMENT_NEW
-
-// --- End infrastructure, data structures ---
-
-// All those things that don't depend on template parameters...
-class SearcherBase
+// Alternative open list for integer scores (the default, see JPS_NO_FLOAT): One bucket per f value (Dial's algorithm).
+// Push and pop are O(1) amortized; there are no comparisons at all.
+// Instead of moving a node whose f decreased, it's added again to its new bucket.
+// The old entry stays behind and is skipped when it comes up (lazy deletion), since the node's f doesn't match anymore.
+// Uses memory proportional to the largest f value, so this is meant for grids with a few thousand cells along each axis, not millions.
+// Not a good fit for JPS_OCTILE: f values get 1000x larger and rarely tie, so most buckets are empty and have to be skipped.
+// Pass as third template parameter to Searcher to use it.
+class BucketOpenList
 {
-protected:
-    Storage storage;
-    OpenList open;
-    NodeMap nodemap;
+private:
+    struct Entry
+    {
+        SizeT idx;  // node index in storage
+        SizeT next; // next entry in the same bucket, or in the free list
+    };
 
-    Position endPos;
-    SizeT endNodeIdx;
-    JPS_Flags flags;
-    int stepsRemain;
-    SizeT stepsDone;
+    Storage& _storageRef;
+    PodVec<SizeT> _heads;   // first entry of each bucket, indexed by f
+    PodVec<Entry> _entries;
+    SizeT _free;            // first unused entry
+    SizeT _cur;             // no non-empty bucket below this one
+    SizeT _live;            // number of nodes in the list, not counting outdated entries; never more than there are valid entries
 
+public:
 
-    SearcherBase(void *user)
-        : storage(user)
-        , open(storage)
-        , nodemap(storage)
-        , endPos(npos), endNodeIdx(noidx)
-        , flags(0)
-        , stepsRemain(0), stepsDone(0)
+    BucketOpenList(Storage& storage)
+        : _storageRef(storage), _heads(storage._user), _entries(storage._user)
+        , _free(noidx), _cur(noidx), _live(0)
     {}
 
-    void clear()
+    inline void pushNode(Node *n)
     {
-        open.clear();
-        nodemap.clear();
-        storage.clear();
-        endNodeIdx = noidx;
-        stepsDone = 0;
+        if(_push(_storageRef.getindex(n), n->f))
+            ++_live;
     }
 
-    void _expandNode(const Position jp, Node& jn, const Node& parent)
+    Node& popNode()
     {
-        JPS_ASSERT(jn.pos == jp);
-        ScoreType extraG = JPS_HEURISTIC_ACCURATE(jp, parent.pos);
-        ScoreType newG = parent.g + extraG;
-        if(!jn.isOpen() || newG < jn.g)
+        JPS_ASSERT(_live);
+        for(;;)
         {
-            jn.g = newG;
-            jn.f = jn.g + JPS_HEURISTIC_ESTIMATE(jp, endPos);
-            jn.setParent(parent);
-            if(!jn.isOpen())
+            while(_heads[_cur] == noidx)
             {
-                open.pushNode(&jn);
-                jn.setOpen();
+                ++_cur;
+                JPS_ASSERT(_cur < _heads.size()); // there is a valid entry left as long as _live > 0
+            }
+            const SizeT e = _heads[_cur];
+            Entry& ent = _entries[e];
+            _heads[_cur] = ent.next;
+            ent.next = _free;
+            _free = e;
+            Node& n = _storageRef[ent.idx];
+            if(!n.isClosed() && SizeT(n.f) == _cur) // otherwise the node was moved to a lower bucket and this entry is outdated
+            {
+                --_live;
+                return n;
             }
-            else
-                open.fixNode(jn);
         }
     }
 
-public:
-
-    template <typename PV>
-    JPS_Result generatePath(PV& path, unsigned step) const;
+    // f of a node in the list decreased. Its old entry is outdated now, so if there's no memory for a new one,
+    // the node is dropped from the list, just like pushNode() drops a node then.
+    inline void fixNode(const Node& n)
+    {
+        if(!_push(_storageRef.getindex(&n), n.f) && _live)
+            --_live;
+    }
 
-    void freeMemory()
+    inline void dealloc()
     {
-        open.dealloc();
-        nodemap.dealloc();
-        storage.dealloc();
-        endNodeIdx = noidx;
+        _heads.dealloc();
+        _entries.dealloc();
+        clear();
+    }
+    inline void clear()
+    {
+        _heads.clear();
+        _entries.clear();
+        _free = noidx;
+        _cur = noidx;
+        _live = 0;
     }
+    inline bool empty() const { return !_live; }
 
-    // --- Statistics ---
+    inline SizeT _getMemSize() const
+    {
+        return _heads._getMemSize() + _entries._getMemSize();
+    }
 
-    inline SizeT getStepsDone() const { return stepsDone; }
-    inline SizeT getNodesExpanded() const { return storage.size(); }
+private:
 
-    SizeT getTotalMemoryInUse() const
+    bool _push(SizeT idx, ScoreType f)
     {
-        return storage._getMemSize()
-             + nodemap._getMemSize()
-             + open._getMemSize();
+        JPS_ASSERT(f >= 0);
+        const SizeT b = SizeT(f);
+        const SizeT nb = _heads.size();
+        if(b >= nb)
+        {
+            if(!_heads._reserve(b + (b / 2) + 32))
+                return false;
+            _heads.resize(b + 1);
+            for(SizeT i = nb; i <= b; ++i)
+                _heads[i] = noidx;
+        }
+
+        SizeT e = _free;
+        if(e != noidx)
+            _free = _entries[e].next;
+        else
+        {
+            e = _entries.size();
+            if(!_entries.alloc())
+                return false;
+        }
+        Entry& ent = _entries[e];
+        ent.idx = idx;
+        ent.next = _heads[b];
+        _heads[b] = e;
+        if(b < _cur)
+            _cur = b; // the estimate heuristic isn't consistent, so f may go down along a path
+        return true;
     }
 };
 
-template <typename GRID> class Searcher : public SearcherBase
+#undef JPS_PLACEMENT_NEW
+
+// --- End infrastructure, data structures ---
+
+// --- Ready-made grid type ---
+
+// One bit per cell, 64 cells per word, stored line by line.
+// Cell a of line b is at bit a+64 of the line: Each line has a zero padding word before and after,
+// and there is one zero padding line before the first and after the last line.
+class BitPlane
+{
+public:
+    BitPlane(void *user)
+        : _words(user), _stride(0)
+    {}
+
+    bool init(PosType len, PosType lines)
+    {
+        const SizeT stride = ((len + 63) >> 6) + 2;
+        const SizeT n = stride * (lines + 2);
+        _words.resize(n);
+        if(_words.size() != n)
+        {
+            dealloc();
+            return false;
+        }
+        for(BitWord *p = _words.begin(); p != _words.end(); ++p)
+            *p = 0;
+        _stride = stride;
+        return true;
+    }
+
+    void dealloc()
+    {
+        _words.dealloc();
+        _stride = 0;
+    }
+
+    inline unsigned get(PosType a, PosType b) const
+    {
+        return unsigned(_word(a, b) >> ((a + 64) & 63)) & 1;
+    }
+    inline void set(PosType a, PosType b) { _word(a, b) |= _bit(a); }
+    inline void unset(PosType a, PosType b) { _word(a, b) &= ~_bit(a); }
+
+    // 64 cells starting at (a, b), from lowest to highest bit
+    inline BitWord bits(PosType a, PosType b) const
+    {
+        const BitWord *line = _words.data() + size_t(b + 1) * _stride;
+        const unsigned pos = a + 64;
+        const unsigned w = pos >> 6, sh = pos & 63;
+        BitWord r = line[w] >> sh;
+        if(sh)
+            r |= line[w + 1] << (64 - sh); // w+1 is at most the padding word at the end of the line
+        return r;
+    }
+
+    // Bit i is the cell at (a + i*dir, b)
+    inline BitWord bitsDir(PosType a, PosType b, int dir) const
+    {
+        return dir > 0 ? bits(a, b) : ReverseBits(bits(a - 63, b));
+    }
+
+    inline SizeT _getMemSize() const { return _words._getMemSize(); }
+
+private:
+    inline BitWord _word(PosType a, PosType b) const
+    {
+        return _words.data()[size_t(b + 1) * _stride + ((a + 64) >> 6)];
+    }
+    inline BitWord& _word(PosType a, PosType b)
+    {
+        return _words.data()[size_t(b + 1) * _stride + ((a + 64) >> 6)];
+    }
+    inline static BitWord _bit(PosType a)
+    {
+        return BitWord(1) << ((a + 64) & 63);
+    }
+
+    PodVec<BitWord> _words;
+    SizeT _stride;
+};
+
+// Compact grid that stores one bit per cell (1 = walkable).
+// Surrounded by a blocked border, so it doesn't need any bounds checks:
+// Coordinates from -1 up to and including width/height are fine; JPS never goes further than that
+// as long as the start and end positions you pass are inside the grid.
+// Keeps a row-major and a transposed (column-major) copy, so that both horizontal and vertical
+// jumps can scan 64 cells at a time from contiguous memory. Costs 2 bits per cell in total.
+// This is about as fast as a grid functor can get, so use this unless your map data are special.
+// Usage:
+//   JPS::BitGrid grid;
+//   grid.initFromMovingAI(text, textlen); // or grid.initFromBytes(cells, w, h), or grid.init(w, h) + grid.set(x, y, true)
+//   JPS::Searcher<JPS::BitGrid> search(grid);
+class BitGrid
+{
+public:
+    BitGrid(void *user = 0)
+        : _rows(user), _cols(user), _w(0), _h(0)
+    {}
+
+    // All cells blocked. Returns false if out of memory.
+    bool init(PosType w, PosType h)
+    {
+        _w = _h = 0;
+        if(!_rows.init(w, h) || !_cols.init(h, w))
+        {
+            _rows.dealloc();
+            return false;
+        }
+        _w = w;
+        _h = h;
+        return true;
+    }
+
+    // Row-major, w*h bytes. Nonzero bytes are walkable.
+    bool initFromBytes(const unsigned char *cells, PosType w, PosType h)
+    {
+        if(!init(w, h))
+            return false;
+        for(PosType y = 0; y < h; ++y, cells += w)
+            for(PosType x = 0; x < w; ++x)
+                if(cells[x])
+                    _setbit(x, y);
+        return true;
+    }
+
+    // Text in the format of the map files from http://www.movingai.com/benchmarks/:
+    //   type octile
+    //   height <h>
+    //   width <w>
+    //   map
+    //   <h lines of w characters>
+    // '.', 'G' and 'S' are walkable, everything else is not.
+    // Returns false if the text is malformed or out of memory.
+    bool initFromMovingAI(const char *text, size_t len)
+    {
+        const char * const end = text + len;
+        PosType w = 0, h = 0;
+        bool haveW = false, haveH = false;
+        while(text < end) // header
+        {
+            const char *word = text;
+            while(text < end && !_isspace(*text))
+                ++text;
+            const size_t wlen = size_t(text - word);
+            text = _skipspace(text, end);
+            if(_wordeq(word, wlen, "map"))
+                break;
+            else if(_wordeq(word, wlen, "width"))
+                haveW = _readnum(text, end, w);
+            else if(_wordeq(word, wlen, "height"))
+                haveH = _readnum(text, end, h);
+        }
+        if(!haveW || !haveH || !init(w, h))
+            return false;
+
+        for(PosType y = 0; y < h; ++y)
+        {
+            text = _skipspace(text, end);
+            if(size_t(end - text) < w)
+                return false;
+            for(PosType x = 0; x < w; ++x)
+            {
+                const char c = text[x];
+                if(c == '.' || c == 'G' || c == 'S')
+                    _setbit(x, y);
+                else if(_isspace(c))
+                    return false; // line too short
+            }
+            text += w;
+        }
+        return true;
+    }
+
+    // Updates both copies; that's two bit operations.
+    inline void set(PosType x, PosType y, bool walkable)
+    {
+        JPS_ASSERT(x < _w && y < _h);
+        if(walkable)
+            _setbit(x, y);
+        else
+        {
+            _rows.unset(x, y);
+            _cols.unset(y, x);
+        }
+    }
+
+    inline unsigned operator()(PosType x, PosType y) const
+    {
+        JPS_ASSERT(x + 1 <= _w + 1 && y + 1 <= _h + 1); // unsigned, so -1 wraps to 0
+        return _rows.get(x, y);
+    }
+
+    // 64 cells at once: Bit i is the cell at (x + i*dir, y). Used by the Searcher for faster jumps.
+    inline BitWord getRowBits(PosType x, PosType y, int dir) const
+    {
+        return _rows.bitsDir(x, y, dir);
+    }
+
+    // Same for columns: Bit i is the cell at (x, y + i*dir). Reads the transposed copy.
+    inline BitWord getColBits(PosType x, PosType y, int dir) const
+    {
+        return _cols.bitsDir(y, x, dir);
+    }
+
+    inline PosType width() const { return _w; }
+    inline PosType height() const { return _h; }
+
+    inline SizeT _getMemSize() const
+    {
+        return _rows._getMemSize() + _cols._getMemSize();
+    }
+
+private:
+    inline void _setbit(PosType x, PosType y)
+    {
+        _rows.set(x, y);
+        _cols.set(y, x);
+    }
+
+    inline static bool _isspace(char c)
+    {
+        return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+    }
+    inline static const char *_skipspace(const char *s, const char *end)
+    {
+        while(s < end && _isspace(*s))
+            ++s;
+        return s;
+    }
+    inline static bool _wordeq(const char *s, size_t len, const char *lit)
+    {
+        size_t i = 0;
+        for( ; i < len && lit[i]; ++i)
+            if(s[i] != lit[i])
+                return false;
+        return i == len && !lit[i];
+    }
+    static bool _readnum(const char *& s, const char *end, PosType& out)
+    {
+        PosType n = 0;
+        const char *beg = s;
+        for( ; s < end && *s >= '0' && *s <= '9'; ++s)
+            n = n * 10 + PosType(*s - '0');
+        out = n;
+        return s != beg;
+    }
+
+    BitPlane _rows; // (x, y)
+    BitPlane _cols; // transposed: (y, x)
+    PosType _w, _h;
+
+    // forbid ops
+    BitGrid& operator=(const BitGrid&);
+    BitGrid(const BitGrid&);
+};
+
+
+// --- Preprocessing for static grids ---
+
+// Index for each of the 8 directions, used by JumpTable and GoalBounds
+enum DirIndex { DIR_R, DIR_L, DIR_D, DIR_U, DIR_RD, DIR_LD, DIR_RU, DIR_LU };
+
+static inline unsigned DirIdx(int dx, int dy)
+{
+    JPS_ASSERT(dx || dy);
+    if(!dy)
+        return dx > 0 ? DIR_R : DIR_L;
+    if(!dx)
+        return dy > 0 ? DIR_D : DIR_U;
+    return DIR_RD + (dx < 0) + 2 * (dy < 0);
+}
+
+// Inverse of DirIdx()
+static const signed char DirX[8] = { 1, -1, 0, 0, 1, -1, 1, -1 };
+static const signed char DirY[8] = { 0, 0, 1, -1, 1, 1, -1, -1 };
+
+
+// Precomputed jumps (JPS+) for a static grid.
+// For every cell and each of the 8 directions, stores how many steps a jump goes until it hits a jump point or a wall.
+// With this, a Searcher jumps in O(1) instead of scanning the grid. The end position is taken into account at lookup time,
+// so the results are exactly the same as without the table.
+// Uses 18 bytes per cell. Grid dimensions must be < 65536.
+// The grid must not change while the table is in use; rebuild the table after changing the grid.
+// Usage:
+//   JPS::JumpTable jt;
+//   jt.init(grid, width, height); // slow, do this once
+//   JPS::Searcher<MyGrid> search(grid);
+//   search.setJumpTable(&jt); // pass NULL to go back to normal jumps
+class JumpTable
+{
+public:
+    struct Entry
+    {
+        unsigned short dist[8]; // steps to go in each direction, indexed by DirIdx()
+        unsigned char jp; // bit set for each direction where the jump ends at a jump point; otherwise the last cell before a wall
+        unsigned char _pad;
+    };
+
+    JumpTable(void *user = 0)
+        : _entries(user), _w(0), _h(0)
+    {}
+
+    // Scans the whole grid. Returns false if out of memory or the grid is too large.
+    template<typename GRID> bool init(const GRID& grid, PosType w, PosType h)
+    {
+        _w = _h = 0;
+        if(w >= 0x10000 || h >= 0x10000)
+            return false;
+        const SizeT n = w * h;
+        _entries.resize(n);
+        if(_entries.size() != n)
+            return false;
+        _w = w;
+        _h = h;
+
+        // Straight directions first; the diagonals depend on them
+        _fill(grid, 1, 0);
+        _fill(grid, -1, 0);
+        _fill(grid, 0, 1);
+        _fill(grid, 0, -1);
+        _fill(grid, 1, 1);
+        _fill(grid, -1, 1);
+        _fill(grid, 1, -1);
+        _fill(grid, -1, -1);
+        return true;
+    }
+
+    void dealloc()
+    {
+        _entries.dealloc();
+        _w = _h = 0;
+    }
+
+    inline const Entry& get(PosType x, PosType y) const
+    {
+        JPS_ASSERT(x < _w && y < _h);
+        return _entries[size_t(y) * _w + x];
+    }
+
+    inline PosType width() const { return _w; }
+    inline PosType height() const { return _h; }
+
+    inline SizeT _getMemSize() const
+    {
+        return _entries._getMemSize();
+    }
+
+private:
+    inline Entry& _at(PosType x, PosType y)
+    {
+        return _entries[size_t(y) * _w + x];
+    }
+
+    // Same decisions as Searcher::jumpX(), jumpY(), jumpD(), but without an end position.
+    // Each cell depends on the next cell in direction (dx, dy), so go backwards.
+    template<typename GRID> void _fill(const GRID& grid, const int dx, const int dy)
+    {
+        const unsigned d = DirIdx(dx, dy);
+        const unsigned bit = 1u << d;
+        const unsigned dX = dx ? DirIdx(dx, 0) : 0, dY = dy ? DirIdx(0, dy) : 0; // only used for diagonals
+        for(PosType j = 0; j < _h; ++j)
+        {
+            const PosType y = dy > 0 ? _h - 1 - j : j;
+            for(PosType i = 0; i < _w; ++i)
+            {
+                const PosType x = dx > 0 ? _w - 1 - i : i;
+                Entry& e = _at(x, y);
+                e.dist[d] = 0;
+                e.jp &= ~bit;
+                if(!grid(x, y))
+                    continue;
+
+                bool forced;
+                bool next;
+                if(dx && dy)
+                {
+                    forced = (grid(x-dx, y+dy) && !grid(x-dx, y)) || (grid(x+dx, y-dy) && !grid(x, y-dy));
+                    const bool gdx = !!grid(x+dx, y);
+                    const bool gdy = !!grid(x, y+dy);
+                    forced = forced
+                        || (gdx && (get(x+dx, y).jp & (1u << dX)))
+                        || (gdy && (get(x, y+dy).jp & (1u << dY)));
+                    next = (gdx || gdy) && grid(x+dx, y+dy);
+                }
+                else if(dx)
+                {
+                    forced = (!grid(x, y+1) && grid(x+dx, y+1)) || (!grid(x, y-1) && grid(x+dx, y-1));
+                    next = !!grid(x+dx, y);
+                }
+                else
+                {
+                    forced = (!grid(x+1, y) && grid(x+1, y+dy)) || (!grid(x-1, y) && grid(x-1, y+dy));
+                    next = !!grid(x, y+dy);
+                }
+
+                if(forced)
+                    e.jp |= bit;
+                else if(next)
+                {
+                    const Entry& n = get(x+dx, y+dy);
+                    e.dist[d] = n.dist[d] + 1;
+                    e.jp |= n.jp & bit;
+                }
+            }
+        }
+    }
+
+    PodVec<Entry> _entries;
+    PosType _w, _h;
+
+    // forbid ops
+    JumpTable& operator=(const JumpTable&);
+    JumpTable(const JumpTable&);
+};
+
+// Goal bounding for a static grid.
+// For every cell and each of the 8 directions, stores the bounding box of all cells
+// that have a shortest path (octile distance) from that cell starting with a step in that direction.
+// A Searcher then skips a successor if the end position is outside of the box for that direction.
+// Cuts down the number of expanded nodes a lot, especially for long paths.
+// Preprocessing is very slow (one Dijkstra search per walkable cell), so do this offline and load the result;
+// see test/jps/gbprep.cpp. Uses 64 bytes per cell in memory. Grid dimensions must be < 65536.
+// The grid must not change while the bounds are in use. The start position must be walkable.
+// Usage:
+//   JPS::GoalBounds gb;
+//   gb.init(grid, width, height); // offline, or:
+//   gb.deserialize(data, size);
+//   search.setGoalBounds(&gb); // pass NULL to disable
+class GoalBounds
+{
+public:
+    struct Box
+    {
+        unsigned short minx, miny, maxx, maxy; // inclusive. Empty if minx > maxx
+    };
+
+    GoalBounds(void *user = 0)
+        : _boxes(user), _w(0), _h(0)
+    {}
+
+    template<typename GRID> bool init(const GRID& grid, PosType w, PosType h);
+
+    void dealloc()
+    {
+        _boxes.dealloc();
+        _w = _h = 0;
+    }
+
+    // Whether going from 'from' one step into direction (dx, dy) may be the start of a shortest path to 'goal'
+    inline bool mayReach(const Position& from, int dx, int dy, const Position& goal) const
+    {
+        if(from.x >= _w || from.y >= _h)
+            return true;
+        const Box& b = _boxes[(size_t(from.y) * _w + from.x) * 8 + DirIdx(dx, dy)];
+        return b.minx <= goal.x && goal.x <= b.maxx && b.miny <= goal.y && goal.y <= b.maxy;
+    }
+
+    inline const Box& get(PosType x, PosType y, unsigned dir) const
+    {
+        JPS_ASSERT(x < _w && y < _h && dir < 8);
+        return _boxes[(size_t(y) * _w + x) * 8 + dir];
+    }
+
+    inline PosType width() const { return _w; }
+    inline PosType height() const { return _h; }
+
+    // Serialized form: "JGB1", u16 width, u16 height, then per cell: u8 mask of non-empty boxes, followed by those boxes (4x u16 each).
+    // All little endian.
+    size_t serializedSize() const
+    {
+        size_t n = 8;
+        for(const Box *b = _boxes.cbegin(); b != _boxes.cend(); ++b)
+            n += (b->minx <= b->maxx) * 8;
+        return n + size_t(_w) * _h;
+    }
+
+    // dst must have room for serializedSize() bytes
+    void serialize(void *dst) const
+    {
+        unsigned char *p = static_cast<unsigned char*>(dst);
+        *p++ = 'J'; *p++ = 'G'; *p++ = 'B'; *p++ = '1';
+        p = _put16(p, _w);
+        p = _put16(p, _h);
+        for(const Box *b = _boxes.cbegin(); b != _boxes.cend(); b += 8)
+        {
+            unsigned char *maskp = p++;
+            unsigned mask = 0;
+            for(unsigned d = 0; d < 8; ++d)
+                if(b[d].minx <= b[d].maxx)
+                {
+                    mask |= 1u << d;
+                    p = _put16(p, b[d].minx);
+                    p = _put16(p, b[d].miny);
+                    p = _put16(p, b[d].maxx);
+                    p = _put16(p, b[d].maxy);
+                }
+            *maskp = (unsigned char)mask;
+        }
+    }
+
+    // Returns false if the data are malformed or out of memory
+    bool deserialize(const void *src, size_t size)
+    {
+        const unsigned char *p = static_cast<const unsigned char*>(src);
+        const unsigned char * const end = p + size;
+        dealloc();
+        if(size < 8 || p[0] != 'J' || p[1] != 'G' || p[2] != 'B' || p[3] != '1')
+            return false;
+        const PosType w = _get16(p + 4), h = _get16(p + 6);
+        p += 8;
+        if(!_alloc(w, h))
+            return false;
+        for(Box *b = _boxes.begin(); b != _boxes.end(); b += 8)
+        {
+            if(p >= end)
+                return _fail();
+            const unsigned mask = *p++;
+            for(unsigned d = 0; d < 8; ++d)
+                if(mask & (1u << d))
+                {
+                    if(end - p < 8)
+                        return _fail();
+                    b[d].minx = _get16(p);
+                    b[d].miny = _get16(p + 2);
+                    b[d].maxx = _get16(p + 4);
+                    b[d].maxy = _get16(p + 6);
+                    p += 8;
+                }
+        }
+        return p == end || _fail();
+    }
+
+    inline SizeT _getMemSize() const
+    {
+        return _boxes._getMemSize();
+    }
+
+private:
+    bool _alloc(PosType w, PosType h)
+    {
+        const SizeT n = w * h * 8;
+        _boxes.resize(n);
+        if(_boxes.size() != n)
+            return false;
+        const Box empty = { 0xffff, 0xffff, 0, 0 };
+        for(Box *b = _boxes.begin(); b != _boxes.end(); ++b)
+            *b = empty;
+        _w = w;
+        _h = h;
+        return true;
+    }
+    bool _fail()
+    {
+        dealloc();
+        return false;
+    }
+    static unsigned char *_put16(unsigned char *p, unsigned v)
+    {
+        p[0] = (unsigned char)(v & 0xff);
+        p[1] = (unsigned char)(v >> 8);
+        return p + 2;
+    }
+    static unsigned _get16(const unsigned char *p)
+    {
+        return p[0] | (p[1] << 8);
+    }
+
+    struct HeapEntry
+    {
+        unsigned dist;
+        SizeT cell;
+    };
+    static bool _heapPush(PodVec<HeapEntry>& heap, const HeapEntry& e)
+    {
+        SizeT i = heap.size();
+        if(!heap.alloc())
+            return false;
+        while(i)
+        {
+            const SizeT p = (i - 1) >> 1;
+            if(heap[p].dist <= e.dist)
+                break;
+            heap[i] = heap[p];
+            i = p;
+        }
+        heap[i] = e;
+        return true;
+    }
+    static HeapEntry _heapPop(PodVec<HeapEntry>& heap)
+    {
+        const HeapEntry top = heap[0];
+        const HeapEntry e = heap.back();
+        heap.pop_back();
+        const SizeT sz = heap.size();
+        if(sz)
+        {
+            SizeT i = 0;
+            while(true)
+            {
+                SizeT c = (i << 1) + 1;
+                if(c >= sz)
+                    break;
+                if(c + 1 < sz && heap[c + 1].dist < heap[c].dist)
+                    ++c;
+                if(e.dist <= heap[c].dist)
+                    break;
+                heap[i] = heap[c];
+                i = c;
+            }
+            heap[i] = e;
+        }
+        return top;
+    }
+
+    PodVec<Box> _boxes;
+    PosType _w, _h;
+
+    // forbid ops
+    GoalBounds& operator=(const GoalBounds&);
+    GoalBounds(const GoalBounds&);
+};
+
+template<typename GRID> bool GoalBounds::init(const GRID& grid, PosType w, PosType h)
+{
+    dealloc();
+    if(w >= 0x10000 || h >= 0x10000 || !_alloc(w, h))
+        return false;
+
+    // Octile distance in fixed point, sqrt(2) ~= 1.414
+    const unsigned cost[8] = { 1000, 1000, 1000, 1000, 1414, 1414, 1414, 1414 };
+    const unsigned INF = unsigned(-1);
+    const SizeT n = w * h;
+    PodVec<unsigned> dist(_boxes._user);
+    PodVec<unsigned char> first(_boxes._user); // bit set for each direction that starts a shortest path
+    PodVec<HeapEntry> heap(_boxes._user);
+    dist.resize(n);
+    first.resize(n);
+    if(dist.size() != n || first.size() != n)
+        return _fail();
+
+    for(PosType sy = 0; sy < h; ++sy)
+        for(PosType sx = 0; sx < w; ++sx)
+        {
+            if(!grid(sx, sy))
+                continue;
+            for(SizeT i = 0; i < n; ++i)
+                dist[i] = INF;
+            const SizeT src = size_t(sy) * w + sx;
+            dist[src] = 0;
+            first[src] = 0;
+            heap.clear();
+            HeapEntry start = { 0, src };
+            if(!_heapPush(heap, start))
+                return _fail();
+
+            // Dijkstra. All cells leading to a cell with the same cost contribute their first moves.
+            while(!heap.empty())
+            {
+                const HeapEntry cur = _heapPop(heap);
+                if(cur.dist > dist[cur.cell])
+                    continue; // outdated
+                const PosType x = cur.cell % w, y = cur.cell / w;
+                for(unsigned d = 0; d < 8; ++d)
+                {
+                    const int dx = DirX[d], dy = DirY[d];
+                    const PosType nx = x + dx, ny = y + dy;
+                    if(!grid(nx, ny) || (dx && dy && !grid(nx, y) && !grid(x, ny))) // no tunneling, same as Searcher
+                        continue;
+                    const SizeT nc = size_t(ny) * w + nx;
+                    const unsigned nd = cur.dist + cost[d];
+                    const unsigned char fm = cur.cell == src ? (unsigned char)(1u << d) : first[cur.cell];
+                    if(nd < dist[nc])
+                    {
+                        dist[nc] = nd;
+                        first[nc] = fm;
+                        HeapEntry e = { nd, nc };
+                        if(!_heapPush(heap, e))
+                            return _fail();
+                    }
+                    else if(nd == dist[nc])
+                        first[nc] |= fm;
+                }
+            }
+
+            Box *boxes = &_boxes[src * 8];
+            for(SizeT i = 0; i < n; ++i)
+                if(i != src && dist[i] != INF)
+                {
+                    const unsigned short x = (unsigned short)(i % w), y = (unsigned short)(i / w);
+                    for(unsigned d = 0; d < 8; ++d)
+                        if(first[i] & (1u << d))
+                        {
+                            Box& b = boxes[d];
+                            b.minx = Min(b.minx, x);
+                            b.miny = Min(b.miny, y);
+                            b.maxx = Max(b.maxx, x);
+                            b.maxy = Max(b.maxy, y);
+                        }
+                }
+        }
+    return true;
+}
+
+// --- Connectivity ---
+
+// Connected components of the grid, to reject unreachable end positions without searching.
+// Cells reachable by the Searcher's moves are exactly those reachable by straight moves,
+// since a diagonal step is only allowed if one of the two straight detours is walkable.
+// So this uses 4-connectivity (union-find over cells).
+// Supports grid changes: Call update() after changing a cell.
+// Opening a cell merges components right away. Blocking a cell may split a component; that can't be
+// undone with union-find, so the map stays conservative (still says "connected") and becomes dirty,
+// unless a quick local check shows that no split is possible. Call rebuild() when convenient to get exact results again.
+// Uses 5 bytes per cell.
+// Usage:
+//   JPS::ComponentMap cm;
+//   cm.init(grid, width, height);
+//   search.setComponentMap(&cm); // pass NULL to disable
+//   ... change grid cell (x, y) ...
+//   cm.update(grid, x, y);
+//   if(cm.isDirty()) cm.rebuild(grid); // optional, whenever convenient
+class ComponentMap
+{
+public:
+    ComponentMap(void *user = 0)
+        : _parent(user), _rank(user), _w(0), _h(0), _dirty(false)
+    {}
+
+    // Returns false if out of memory
+    template<typename GRID> bool init(const GRID& grid, PosType w, PosType h)
+    {
+        _w = _h = 0;
+        const SizeT n = w * h;
+        _parent.resize(n);
+        _rank.resize(n);
+        if(_parent.size() != n || _rank.size() != n)
+        {
+            dealloc();
+            return false;
+        }
+        _w = w;
+        _h = h;
+        return rebuild(grid);
+    }
+
+    // Recompute everything from scratch. Makes the map exact again.
+    template<typename GRID> bool rebuild(const GRID& grid)
+    {
+        for(PosType y = 0; y < _h; ++y)
+            for(PosType x = 0; x < _w; ++x)
+            {
+                const SizeT i = _idx(x, y);
+                _rank[i] = 0;
+                if(!grid(x, y))
+                    _parent[i] = noidx;
+                else
+                {
+                    _parent[i] = i;
+                    if(x && _parent[i - 1] != noidx)
+                        _union(i, i - 1);
+                    if(y && _parent[i - _w] != noidx)
+                        _union(i, i - _w);
+                }
+            }
+        for(SizeT i = 0; i < _parent.size(); ++i) // flatten, so that queries take at most 1 hop
+            if(_parent[i] != noidx)
+                _parent[i] = _find(i);
+        _dirty = false;
+        return true;
+    }
+
+    // Call after cell (x, y) of the grid was changed
+    template<typename GRID> void update(const GRID& grid, PosType x, PosType y)
+    {
+        JPS_ASSERT(x < _w && y < _h);
+        const SizeT i = _idx(x, y);
+        if(!grid(x, y) == !_walkable(i))
+            return; // no change
+        if(grid(x, y))
+        {
+            if(_parent[i] == noidx)
+            {
+                _parent[i] = i;
+                _rank[i] = 0;
+            }
+            else
+                _rank[i] &= ~BLOCKED;
+            if(x && _walkable(i - 1))
+                _union(i, i - 1);
+            if(x + 1 < _w && _walkable(i + 1))
+                _union(i, i + 1);
+            if(y && _walkable(i - _w))
+                _union(i, i - _w);
+            if(y + 1 < _h && _walkable(i + _w))
+                _union(i, i + _w);
+        }
+        else
+        {
+            // Other cells may be linked through this one, so it stays in the tree, just flagged as blocked.
+            // The component stays in one piece, so this is conservative.
+            _rank[i] |= BLOCKED;
+            if(_maySplit(grid, x, y))
+                _dirty = true;
+        }
+    }
+
+    inline bool isDirty() const { return _dirty; }
+
+    // False if there is definitely no path between a and b. Positions outside of the grid are never connected.
+    bool connected(const Position& a, const Position& b) const
+    {
+        if(a.x >= _w || a.y >= _h || b.x >= _w || b.y >= _h)
+            return false;
+        const SizeT ia = _idx(a.x, a.y), ib = _idx(b.x, b.y);
+        if(!_walkable(ia) || !_walkable(ib))
+            return false;
+        return _find(ia) == _find(ib);
+    }
+
+    void dealloc()
+    {
+        _parent.dealloc();
+        _rank.dealloc();
+        _w = _h = 0;
+        _dirty = false;
+    }
+
+    inline SizeT _getMemSize() const
+    {
+        return _parent._getMemSize() + _rank._getMemSize();
+    }
+
+private:
+    enum { BLOCKED = 0x80 }; // in _rank
+
+    inline SizeT _idx(PosType x, PosType y) const { return SizeT(y) * _w + x; }
+    inline bool _walkable(SizeT i) const { return _parent[i] != noidx && !(_rank[i] & BLOCKED); }
+
+    // No path compression, so this stays const and thread-safe. Union by rank keeps the trees flat.
+    SizeT _find(SizeT i) const
+    {
+        while(_parent[i] != i)
+            i = _parent[i];
+        return i;
+    }
+
+    void _union(SizeT a, SizeT b)
+    {
+        a = _find(a);
+        b = _find(b);
+        if(a == b)
+            return;
+        const unsigned ra = _rank[a] & ~BLOCKED, rb = _rank[b] & ~BLOCKED;
+        if(ra < rb)
+            _parent[a] = b;
+        else
+        {
+            _parent[b] = a;
+            if(ra == rb)
+                ++_rank[a]; // stays below BLOCKED since rank <= log2(cells)
+        }
+    }
+
+    // Blocking (x, y) can only split its component if its walkable straight neighbors
+    // are not all connected to each other via the ring of 8 neighbors around it.
+    template<typename GRID> bool _maySplit(const GRID& grid, PosType x, PosType y) const
+    {
+        // Ring in circular order; even indices are the straight neighbors
+        static const int rx[8] = { 0, 1, 1, 1, 0, -1, -1, -1 };
+        static const int ry[8] = { -1, -1, 0, 1, 1, 1, 0, -1 };
+        bool walk[8];
+        for(unsigned k = 0; k < 8; ++k)
+            walk[k] = !!grid(PosType(x + rx[k]), PosType(y + ry[k]));
+
+        unsigned straight = 0, links = 0;
+        for(unsigned k = 0; k < 8; k += 2)
+            if(walk[k])
+            {
+                ++straight;
+                links += walk[k+1] && walk[(k+2) & 7]; // linked to the next straight neighbor via the corner in between
+            }
+        const unsigned groups = links == 4 ? 1 : straight - links;
+        return groups > 1;
+    }
+
+    PodVec<SizeT> _parent; // noidx if not walkable
+    PodVec<unsigned char> _rank;
+    PosType _w, _h;
+    bool _dirty;
+
+    // forbid ops
+    ComponentMap& operator=(const ComponentMap&);
+    ComponentMap(const ComponentMap&);
+};
+
+// Diagonal rule of the policy; all but one branch are compiled out
+template<typename POLICY, typename GRID>
+inline static bool CanStepDiagonal(const GRID& grid, PosType x, PosType y, int dx, int dy)
+{
+    switch(POLICY::diagonal)
+    {
+        case Diagonal_NoCornerCutting:
+            return grid(x+dx, y) && grid(x, y+dy);
+        case Diagonal_Never:
+            return false;
+        default:
+            return grid(x+dx, y) || grid(x, y+dy);
+    }
+}
+
+// One step from (x, y) into direction d (see DirX, DirY), both cells walkable and obeying the diagonal rule
+template<typename POLICY, typename GRID>
+inline static bool CanStep(const GRID& grid, PosType x, PosType y, unsigned d)
+{
+    return grid(x, y) && grid(x + DirX[d], y + DirY[d]) && (d < 4 || CanStepDiagonal<POLICY>(grid, x, y, DirX[d], DirY[d]));
+}
+
+// All those things that don't depend on template parameters...
+class SearcherBase
+{
+protected:
+    Storage storage;
+
+    Position endPos;
+    SizeT endNodeIdx;
+    JPS_Flags flags;
+    int stepsRemain;
+    SizeT stepsDone;
+
+
+    SearcherBase(void *user)
+        : storage(user)
+        , endPos(npos), endNodeIdx(noidx)
+        , flags(0)
+        , stepsRemain(0), stepsDone(0)
+    {}
+
+    void clear()
+    {
+        storage.clear();
+        endNodeIdx = noidx;
+        stepsDone = 0;
+    }
+
+public:
+
+    template <typename PV>
+    JPS_Result generatePath(PV& path, unsigned step) const { return generatePath(path, step, endNodeIdx); }
+
+    // Path from the start to the node with storage index nodeIdx
+    template <typename PV>
+    JPS_Result generatePath(PV& path, unsigned step, SizeT nodeIdx) const;
+
+    // Path from the node with storage index nodeIdx back to where the search started
+    template <typename PV>
+    JPS_Result generatePathToRoot(PV& path, unsigned step, SizeT nodeIdx) const;
+
+    void freeMemory()
+    {
+        storage.dealloc();
+        endNodeIdx = noidx;
+    }
+
+    // --- Statistics ---
+
+    inline SizeT getStepsDone() const { return stepsDone; }
+    inline SizeT getNodesExpanded() const { return storage.size(); }
+
+    SizeT getTotalMemoryInUse() const
+    {
+        return storage._getMemSize();
+    }
+};
+
+// NODEMAP maps positions to nodes. NodeMap works for any grid; for grids with known dimensions, DenseNodeMap is faster.
+// OPENLIST orders the nodes to expand. OpenList is a binary heap; BucketOpenList is faster with integer scores.
+// POLICY selects costs, neighbor expansion and diagonal rule; see SearchPolicy.
+template <typename GRID, typename NODEMAP = NodeMap, typename OPENLIST = OpenList, typename POLICY = SearchPolicy<> > class Searcher : public SearcherBase
+{
+public:
+    Searcher(const GRID& g, void *user = 0)
+        : SearcherBase(user), nodemap(storage), open(storage), grid(g), jumptable(0), goalbounds(0), components(0)
+        , weight(100), anytimeStep(0), curWeight(100), found(false), fromGoals(false)
+    {}
+
+    void freeMemory()
+    {
+        SearcherBase::freeMemory();
+        nodemap.dealloc();
+        open.dealloc();
+    }
+
+    SizeT getTotalMemoryInUse() const
+    {
+        return SearcherBase::getTotalMemoryInUse()
+             + nodemap._getMemSize()
+             + open._getMemSize();
+    }
+
+    inline NODEMAP& getNodeMap() { return nodemap; }
+
+    // Use precomputed jumps (JPS+). The table must have been built for this grid. Pass NULL to disable.
+    inline void setJumpTable(const JumpTable *jt) { JPS_ASSERT(!jt || POLICY::diagonal == Diagonal_NoTunneling); jumptable = jt; }
+
+    // Skip successors that can't be on a shortest path to the end position. Must have been built for this grid. Pass NULL to disable.
+    inline void setGoalBounds(const GoalBounds *gb) { JPS_ASSERT(!gb || POLICY::diagonal == Diagonal_NoTunneling); goalbounds = gb; }
+
+    // Fail early if start and end are in different components. Must be kept up to date with the grid. Pass NULL to disable.
+    inline void setComponentMap(const ComponentMap *cm) { components = cm; }
+
+    // Weighted search: f = g + h * percent / 100. Expands fewer nodes, and the path is at most percent/100 times
+    // as long as the shortest one, as long as the estimate never overestimates (e.g. Heuristic::OctileCosts).
+    // 100 (the default) is plain search. Values above ~500 may overflow integer scores on very large maps.
+    // Takes effect with the next findPathInit().
+    inline void setWeight(unsigned percent) { JPS_ASSERT(percent >= 100); weight = percent; }
+
+    // Anytime search (ARA*): After findPathStep() returned JPS_FOUND_PATH, call it again to keep going:
+    // The weight is lowered by this many percent points (down to 100), and the path found so far is improved.
+    // Nodes are reused, so this is cheaper than searching again. 0 (the default) disables this.
+    // Use a high weight via setWeight() to get a first path quickly.
+    inline void setAnytime(unsigned decrease) { anytimeStep = decrease; }
+
+    // Bound for the path found last, in percent of the shortest path. 100 means optimal.
+    inline unsigned getBound() const { return curWeight; }
+
+    // single-call
+    template<typename PV>
+    bool findPath(PV& path, Position start, Position end, unsigned step, JPS_Flags flags = JPS_Flag_Default);
+
+    // incremental pathfinding
+    JPS_Result findPathInit(Position start, Position end, JPS_Flags flags = JPS_Flag_Default);
+    JPS_Result findPathStep(int limit);
+    // generate path after one was found
+    template<typename PV>
+    JPS_Result findPathFinish(PV& path, unsigned step) const;
+
+    // Path to whichever of the n goals is the closest one. Searches from all goals at once until the start is reached,
+    // so this costs about as much as a single findPath() instead of n of them.
+    // The path ends at the goal that was reached; it is empty if start is one of the goals.
+    template<typename PV>
+    bool findPathToNearest(PV& path, Position start, const Position *goals, SizeT n, unsigned step = 0, JPS_Flags flags = JPS_Flag_Default);
+    // incremental version; continue with findPathStep() and findPathFinish() as usual
+    JPS_Result findPathInitNearest(Position start, const Position *goals, SizeT n, JPS_Flags flags = JPS_Flag_Default);
+
+    // Costs from start to each of the n targets with a single search: costs[i] is the cost to targets[i], or noscore if
+    // it can't be reached. All nodes are kept from one target to the next, so each target only expands what the ones
+    // before it didn't. Uses A* expansion, since jumps would skip over targets; the weight from setWeight() is ignored.
+    // The costs are exact if the estimate never overestimates (e.g. Heuristic::OctileCosts). Returns false if out of memory.
+    // Much faster than one A* search per target, and when some targets can't be reached. But JPS expands so few nodes
+    // that on open maps, one findPath() per target may still be faster if all of them can be reached.
+    bool findCostsToMany(Position start, const Position *targets, SizeT n, ScoreType *costs, JPS_Flags flags = JPS_Flag_Default);
+    // After findCostsToMany(): Path to one of the targets that could be reached, same as findPathFinish().
+    // Returns JPS_EMPTY_PATH if target is the start.
+    template<typename PV>
+    JPS_Result findPathFinishTo(PV& path, Position target, unsigned step) const;
+
+    // For internal use (HierSearcher): Expand everything reachable from start. Afterwards, _reachedCost()
+    // is the cost to get to a position, or noscore. Exact with Expand_AStar and Heuristic::NoEstimate.
+    bool _flood(Position start);
+    inline ScoreType _reachedCost(const Position& p) const
+    {
+        const Node *n = nodemap.find(p.x, p.y);
+        return n && n->isOpen() ? n->g : noscore;
+    }
+
+private:
+
+    NODEMAP nodemap;
+    OPENLIST open;
+    const GRID& grid;
+    const JumpTable *jumptable;
+    const GoalBounds *goalbounds;
+    const ComponentMap *components;
+    unsigned weight, anytimeStep;
+    unsigned curWeight; // weight of the running search
+    bool found; // anytime: a path was returned, so the next findPathStep() starts a new round
+    bool fromGoals; // findPathInitNearest(): searched from the goals to the start
+
+    void clear()
+    {
+        SearcherBase::clear();
+        nodemap.clear();
+        open.clear();
+    }
+
+    inline ScoreType _estimate(const Position& p) const
+    {
+        const ScoreType h = POLICY::Costs::Estimate(p, endPos);
+        return curWeight == 100 ? h : ScoreType(h * curWeight / 100);
+    }
+
+    void _expandNode(const Position jp, Node& jn, const Node& parent)
+    {
+        JPS_ASSERT(jn.pos == jp);
+        ScoreType extraG = POLICY::Costs::Cost(jp, parent.pos);
+        ScoreType newG = parent.g + extraG;
+        if(!jn.isOpen() || newG < jn.g)
+        {
+            jn.g = newG;
+            jn.f = jn.g + _estimate(jp);
+            jn.setParent(parent);
+            if(!jn.isOpen())
+            {
+                open.pushNode(&jn);
+                jn.setOpen();
+            }
+            else if(jn.isIdle())
+            {
+                jn.clearIdle();
+                open.pushNode(&jn);
+            }
+            else
+                open.fixNode(jn);
+        }
+    }
+
+    // Anytime only: Found a shorter way to a node that was already expanded in this round.
+    // It is expanded again in the next round.
+    void _improveClosed(const Position jp, Node& jn, const Node& parent)
+    {
+        const ScoreType newG = parent.g + POLICY::Costs::Cost(jp, parent.pos);
+        if(newG < jn.g)
+        {
+            jn.g = newG;
+            jn.setParent(parent);
+            jn.setIncons();
+        }
+    }
+
+    void _nextRound();
+
+    Node *getNode(const Position& pos);
+    bool identifySuccessors(const Node& n);
+    template<bool ASTAR> bool identifySuccessors(const Node& n, BoolConst<ASTAR>);
+    inline bool canStepDiagonal(PosType x, PosType y, int dx, int dy) const;
+
+    bool findPathGreedy(Node *start, Node *end);
+    
+    unsigned findNeighborsAStar(const Node& n, Position *wptr);
+
+    unsigned findNeighborsJPS(const Node& n, Position *wptr) const;
+    Position jumpP(const Position& p, const Position& src);
+    Position jumpTable(const Position& p, int dx, int dy);
+    Position jumpD(Position p, int dx, int dy);
+    Position jumpX(Position p, int dx);
+    Position jumpX(Position p, int dx, BoolConst<false>);
+    Position jumpX(Position p, int dx, BoolConst<true>);
+    Position jumpY(Position p, int dy);
+    Position jumpY(Position p, int dy, BoolConst<false>);
+    Position jumpY(Position p, int dy, BoolConst<true>);
+
+    // forbid any ops
+    Searcher& operator=(const Searcher&);
+    Searcher(const Searcher&);
+};
+
+
+// -----------------------------------------------------------------------
+
+template<typename PV> JPS_Result SearcherBase::generatePath(PV& path, unsigned step, SizeT nodeIdx) const
+{
+    if(nodeIdx == noidx)
+        return JPS_NO_PATH;
+    const SizeT offset = path.size();
+    SizeT added = 0;
+    const Node& endNode = storage[nodeIdx];
+    const Node *next = &endNode;
+    if(!next->hasParent())
+        return JPS_NO_PATH;
+    if(step)
+    {
+        const Node *prev = endNode.getParentOpt();
+        if(!prev)
+            return JPS_NO_PATH;
+        do
+        {
+            const unsigned x = next->pos.x, y = next->pos.y;
+            int dx = int(prev->pos.x - x);
+            int dy = int(prev->pos.y - y);
+            const int adx = Abs(dx);
+            const int ady = Abs(dy);
+            JPS_ASSERT(!dx || !dy || adx == ady); // known to be straight, if diagonal
+            const int steps = Max(adx, ady);
+            dx = int(step) * Sgn(dx);
+            dy = int(step) * Sgn(dy);
+            int dxa = 0, dya = 0;
+            for(int i = 0; i < steps; i += step)
+            {
+                path.push_back(Pos(x+dxa, y+dya));
+                ++added;
+                dxa += dx;
+                dya += dy;
+            }
+            next = prev;
+            prev = prev->getParentOpt();
+        }
+        while (prev);
+    }
+    else
+    {
+        do
+        {
+            JPS_ASSERT(next != &next->getParent());
+            path.push_back(next->pos);
+            ++added;
+            next = &next->getParent();
+        }
+        while (next->hasParent());
+    }
+
+    // JPS::PathVector silently discards push_back() when memory allocation fails;
+    // detect that case and roll back.
+    if(path.size() != offset + added)
+    {
+        path.resize(offset);
+        return JPS_OUT_OF_MEMORY;
+    }
+
+    // Nodes were traversed backwards, fix that
+    Reverse(path.begin() + offset, path.end());
+    return JPS_FOUND_PATH;
+}
+
+// Same output as generatePath() for the reversed path, but with the step counted from the other end of each segment
+template<typename PV> JPS_Result SearcherBase::generatePathToRoot(PV& path, unsigned step, SizeT nodeIdx) const
+{
+    if(nodeIdx == noidx)
+        return JPS_NO_PATH;
+    const SizeT offset = path.size();
+    SizeT added = 0;
+    const Node *next = &storage[nodeIdx];
+    if(!next->hasParent())
+        return JPS_NO_PATH;
+    do
+    {
+        const Node *prev = &next->getParent();
+        if(step)
+        {
+            const unsigned x = next->pos.x, y = next->pos.y;
+            const int dx = int(prev->pos.x - x);
+            const int dy = int(prev->pos.y - y);
+            JPS_ASSERT(!dx || !dy || Abs(dx) == Abs(dy)); // known to be straight, if diagonal
+            const unsigned steps = Max(Abs(dx), Abs(dy));
+            for(unsigned i = step; i < steps; i += step)
+            {
+                path.push_back(Pos(x + Sgn(dx) * i, y + Sgn(dy) * i));
+                ++added;
+            }
+        }
+        path.push_back(prev->pos);
+        ++added;
+        next = prev;
+    }
+    while(next->hasParent());
+
+    if(path.size() != offset + added)
+    {
+        path.resize(offset);
+        return JPS_OUT_OF_MEMORY;
+    }
+    return JPS_FOUND_PATH;
+}
+
+//-----------------------------------------
+
+template <typename GRID, typename NODEMAP, typename OPENLIST, typename POLICY> inline Node *Searcher<GRID, NODEMAP, OPENLIST, POLICY>::getNode(const Position& pos)
+{
+    JPS_ASSERT(grid(pos.x, pos.y));
+    return nodemap(pos.x, pos.y);
+}
+
+template <typename GRID, typename NODEMAP, typename OPENLIST, typename POLICY> Position Searcher<GRID, NODEMAP, OPENLIST, POLICY>::jumpP(const Position &p, const Position& src)
+{
+    JPS_ASSERT(grid(p.x, p.y));
+
+    int dx = int(p.x - src.x);
+    int dy = int(p.y - src.y);
+    JPS_ASSERT(dx || dy);
+
+    if(jumptable)
+        return jumpTable(p, dx, dy);
+
+    if(dx && dy)
+        return jumpD(p, dx, dy);
+    else if(dx)
+        return jumpX(p, dx);
+    else if(dy)
+        return jumpY(p, dy);
+
+    // not reached
+    JPS_ASSERT(false);
+    return npos;
+}
+
+// Lookup in the JPS+ table. The table doesn't know about the end position,
+// so check here whether the jump would have stopped there earlier.
+template <typename GRID, typename NODEMAP, typename OPENLIST, typename POLICY> Position Searcher<GRID, NODEMAP, OPENLIST, POLICY>::jumpTable(const Position& p, int dx, int dy)
+{
+    const JumpTable& jt = *jumptable;
+    const JumpTable::Entry& e = jt.get(p.x, p.y);
+    const unsigned d = DirIdx(dx, dy);
+    const int dist = e.dist[d];
+    stepsDone += dist;
+    stepsRemain -= dist;
+
+    // Steps to the end position along each axis; negative if behind
+    const int kx = dx ? int(endPos.x - p.x) * dx : 0;
+    const int ky = dy ? int(endPos.y - p.y) * dy : 0;
+
+    if(!dy || !dx)
+    {
+        // Straight: The end position must be on the line and not further away than the jump goes
+        if((dx ? endPos.y == p.y : endPos.x == p.x) && kx + ky >= 0 && kx + ky <= dist)
+            return endPos;
+    }
+    else
+    {
+        // Diagonal: Stop at the first cell from which the end position is in reach, if that comes before the jump would stop anyway.
+        int stop = -1;
+        if(kx == ky && kx >= 0 && kx <= dist)
+            stop = kx; // end position is on the diagonal
+        if(ky >= 0 && ky <= dist && kx > ky) // on a row reached by the diagonal, and then horizontally ahead
+        {
+            const Position q = Pos(p.x + dx * (ky + 1), endPos.y);
+            if(grid(q.x, q.y) && kx - ky - 1 <= jt.get(q.x, q.y).dist[DirIdx(dx, 0)])
+                stop = stop < 0 ? ky : Min(stop, ky);
+        }
+        if(kx >= 0 && kx <= dist && ky > kx) // on a column reached by the diagonal, then vertically ahead
+        {
+            const Position q = Pos(endPos.x, p.y + dy * (kx + 1));
+            if(grid(q.x, q.y) && ky - kx - 1 <= jt.get(q.x, q.y).dist[DirIdx(0, dy)])
+                stop = stop < 0 ? kx : Min(stop, kx);
+        }
+        if(stop >= 0)
+            return Pos(p.x + dx * stop, p.y + dy * stop);
+    }
+
+    if(!(e.jp & (1u << d)))
+        return npos; // ran into a wall
+    return Pos(p.x + dx * dist, p.y + dy * dist);
+}
+
+template <typename GRID, typename NODEMAP, typename OPENLIST, typename POLICY> Position Searcher<GRID, NODEMAP, OPENLIST, POLICY>::jumpD(Position p, int dx, int dy)
+{
+    JPS_ASSERT(grid(p.x, p.y));
+    JPS_ASSERT(dx && dy);
+
+    const Position endpos = endPos;
+    unsigned steps = 0;
+
+    while(true)
+    {
+        if(p == endpos)
+            break;
+
+        ++steps;
+        const PosType x = p.x;
+        const PosType y = p.y;
+
+        if( (grid(x-dx, y+dy) && !grid(x-dx, y)) || (grid(x+dx, y-dy) && !grid(x, y-dy)) )
+            break;
+
+        const bool gdx = !!grid(x+dx, y);
+        const bool gdy = !!grid(x, y+dy);
+
+        if(gdx && jumpX(Pos(x+dx, y), dx).isValid())
+            break;
+
+        if(gdy && jumpY(Pos(x, y+dy), dy).isValid())
+            break;
+
+        if((gdx || gdy) && grid(x+dx, y+dy))
+        {
+            p.x += dx;
+            p.y += dy;
+        }
+        else
+        {
+            p = npos;
+            break;
+        }
+    }
+    stepsDone += steps;
+    stepsRemain -= steps;
+    return p;
+}
+
+template <typename GRID, typename NODEMAP, typename OPENLIST, typename POLICY> inline Position Searcher<GRID, NODEMAP, OPENLIST, POLICY>::jumpX(Position p, int dx)
+{
+    return jumpX(p, dx, BoolConst<HasRowBits<GRID>::value>());
+}
+
+// Per-cell version
+template <typename GRID, typename NODEMAP, typename OPENLIST, typename POLICY> inline Position Searcher<GRID, NODEMAP, OPENLIST, POLICY>::jumpX(Position p, int dx, BoolConst<false>)
+{
+    JPS_ASSERT(dx);
+    JPS_ASSERT(grid(p.x, p.y));
+
+    const PosType y = p.y;
+    const Position endpos = endPos;
+    unsigned steps = 0;
+
+    unsigned a = ~((!!grid(p.x, y+1)) | ((!!grid(p.x, y-1)) << 1));
+
+    while(true)
+    {
+        const unsigned xx = p.x + dx;
+        const unsigned b = (!!grid(xx, y+1)) | ((!!grid(xx, y-1)) << 1);
+
+        if((b & a) || p == endpos)
+            break;
+        if(!grid(xx, y))
+        {
+            p = npos;
+            break;
+        }
+
+        p.x += dx;
+        a = ~b;
+        ++steps;
+    }
+
+    stepsDone += steps;
+    stepsRemain -= steps;
+    return p;
+}
+
+// Block-based version, if the grid supports getRowBits().
+// Same logic as above, but checks 63 cells at once.
+template <typename GRID, typename NODEMAP, typename OPENLIST, typename POLICY> Position Searcher<GRID, NODEMAP, OPENLIST, POLICY>::jumpX(Position p, int dx, BoolConst<true>)
+{
+    JPS_ASSERT(dx);
+    JPS_ASSERT(grid(p.x, p.y));
+
+    const PosType y = p.y;
+    const Position endpos = endPos;
+    unsigned steps = 0;
+
+    // Bit position of the end position if it's ahead on this row
+    unsigned endIdx = unsigned(-1);
+    if(endpos.y == y && int(endpos.x - p.x) * dx >= 0)
+        endIdx = unsigned(int(endpos.x - p.x) * dx);
+
+    while(true)
+    {
+        bool isJP = false;
+        const unsigned i = ScanBlock(grid.getRowBits(p.x, y-1, dx), grid.getRowBits(p.x, y, dx), grid.getRowBits(p.x, y+1, dx), endIdx, isJP);
+        steps += i;
+        if(i < 63)
+        {
+            if(isJP)
+                p.x += PosType(int(i) * dx);
+            else
+                p = npos;
+            break;
+        }
+        p.x += PosType(63 * dx);
+        if(endIdx != unsigned(-1))
+            endIdx -= 63;
+    }
+
+    stepsDone += steps;
+    stepsRemain -= steps;
+    return p;
+}
+
+template <typename GRID, typename NODEMAP, typename OPENLIST, typename POLICY> inline Position Searcher<GRID, NODEMAP, OPENLIST, POLICY>::jumpY(Position p, int dy)
+{
+    return jumpY(p, dy, BoolConst<HasColBits<GRID>::value>());
+}
+
+// Per-cell version
+template <typename GRID, typename NODEMAP, typename OPENLIST, typename POLICY> inline Position Searcher<GRID, NODEMAP, OPENLIST, POLICY>::jumpY(Position p, int dy, BoolConst<false>)
+{
+    JPS_ASSERT(dy);
+    JPS_ASSERT(grid(p.x, p.y));
+
+    const PosType x = p.x;
+    const Position endpos = endPos;
+    unsigned steps = 0;
+
+    unsigned a = ~((!!grid(x+1, p.y)) | ((!!grid(x-1, p.y)) << 1));
+
+    while(true)
+    {
+        const unsigned yy = p.y + dy;
+        const unsigned b = (!!grid(x+1, yy)) | ((!!grid(x-1, yy)) << 1);
+
+        if((a & b) || p == endpos)
+            break;
+        if(!grid(x, yy))
+        {
+            p = npos;
+            break;
+        }
+
+        p.y += dy;
+        a = ~b;
+        ++steps;
+    }
+
+    stepsDone += steps;
+    stepsRemain -= steps;
+    return p;
+}
+
+// Block-based version, if the grid supports getColBits()
+template <typename GRID, typename NODEMAP, typename OPENLIST, typename POLICY> Position Searcher<GRID, NODEMAP, OPENLIST, POLICY>::jumpY(Position p, int dy, BoolConst<true>)
+{
+    JPS_ASSERT(dy);
+    JPS_ASSERT(grid(p.x, p.y));
+
+    const PosType x = p.x;
+    const Position endpos = endPos;
+    unsigned steps = 0;
+
+    unsigned endIdx = unsigned(-1);
+    if(endpos.x == x && int(endpos.y - p.y) * dy >= 0)
+        endIdx = unsigned(int(endpos.y - p.y) * dy);
+
+    while(true)
+    {
+        bool isJP = false;
+        const unsigned i = ScanBlock(grid.getColBits(x-1, p.y, dy), grid.getColBits(x, p.y, dy), grid.getColBits(x+1, p.y, dy), endIdx, isJP);
+        steps += i;
+        if(i < 63)
+        {
+            if(isJP)
+                p.y += PosType(int(i) * dy);
+            else
+                p = npos;
+            break;
+        }
+        p.y += PosType(63 * dy);
+        if(endIdx != unsigned(-1))
+            endIdx -= 63;
+    }
+
+    stepsDone += steps;
+    stepsRemain -= steps;
+    return p;
+}
+
+#define JPS_CHECKGRID(dx, dy) (grid(x+(dx), y+(dy)))
+#define JPS_ADDPOS(dx, dy)     do { *w++ = Pos(x+(dx), y+(dy)); } while(0)
+#define JPS_ADDPOS_CHECK(dx, dy) do { if(JPS_CHECKGRID(dx, dy)) JPS_ADDPOS(dx, dy); } while(0)
+#define JPS_ADDPOS_NO_TUNNEL(dx, dy) do { if(grid(x+(dx),y) || grid(x,y+(dy))) JPS_ADDPOS_CHECK(dx, dy); } while(0)
+#define JPS_ADDPOS_DIAGONAL(dx, dy) do { if(canStepDiagonal(x, y, dx, dy)) JPS_ADDPOS_CHECK(dx, dy); } while(0)
+
+template <typename GRID, typename NODEMAP, typename OPENLIST, typename POLICY> unsigned Searcher<GRID, NODEMAP, OPENLIST, POLICY>::findNeighborsJPS(const Node& n, Position *wptr) const
+{
+    Position *w = wptr;
+    const unsigned x = n.pos.x;
+    const unsigned y = n.pos.y;
+
+    if(!n.hasParent())
+    {
+        // straight moves
+        JPS_ADDPOS_CHECK(-1, 0);
+        JPS_ADDPOS_CHECK(0, -1);
+        JPS_ADDPOS_CHECK(0, 1);
+        JPS_ADDPOS_CHECK(1, 0);
+
+        // diagonal moves + prevent tunneling
+        JPS_ADDPOS_NO_TUNNEL(-1, -1);
+        JPS_ADDPOS_NO_TUNNEL(-1, 1);
+        JPS_ADDPOS_NO_TUNNEL(1, -1);
+        JPS_ADDPOS_NO_TUNNEL(1, 1);
+
+        return unsigned(w - wptr);
+    }
+    const Node& p = n.getParent();
+    // jump directions (both -1, 0, or 1)
+    const int dx = Sgn<int>(x - p.pos.x);
+    const int dy = Sgn<int>(y - p.pos.y);
+
+    if(dx && dy)
+    {
+        // diagonal
+        // natural neighbors
+        const bool walkX = !!grid(x+dx, y);
+        if(walkX)
+            *w++ = Pos(x+dx, y);
+        const bool walkY = !!grid(x, y+dy);
+        if(walkY)
+            *w++ = Pos(x, y+dy);
+
+        if(walkX || walkY)
+            JPS_ADDPOS_CHECK(dx, dy);
+
+        // forced neighbors
+        if(walkY && !JPS_CHECKGRID(-dx,0))
+            JPS_ADDPOS_CHECK(-dx, dy);
+
+        if(walkX && !JPS_CHECKGRID(0,-dy))
+            JPS_ADDPOS_CHECK(dx, -dy);
+    }
+    else if(dx)
+    {
+        // along X axis
+        if(JPS_CHECKGRID(dx, 0))
+        {
+            JPS_ADDPOS(dx, 0);
+
+             // Forced neighbors (+ prevent tunneling)
+            if(!JPS_CHECKGRID(0, 1))
+                JPS_ADDPOS_CHECK(dx, 1);
+            if(!JPS_CHECKGRID(0,-1))
+                JPS_ADDPOS_CHECK(dx,-1);
+        }
+    }
+    else if(dy)
+    {
+        // along Y axis
+        if(JPS_CHECKGRID(0, dy))
+        {
+            JPS_ADDPOS(0, dy);
+
+            // Forced neighbors (+ prevent tunneling)
+            if(!JPS_CHECKGRID(1, 0))
+                JPS_ADDPOS_CHECK(1, dy);
+            if(!JPS_CHECKGRID(-1, 0))
+                JPS_ADDPOS_CHECK(-1,dy);
+        }
+    }
+
+    return unsigned(w - wptr);
+}
+
+//-------------- Plain old A* search ----------------
+template <typename GRID, typename NODEMAP, typename OPENLIST, typename POLICY> unsigned Searcher<GRID, NODEMAP, OPENLIST, POLICY>::findNeighborsAStar(const Node& n, Position *wptr)
+{
+    Position *w = wptr;
+    const int x = n.pos.x;
+    const int y = n.pos.y;
+    const int d = 1;
+    JPS_ADDPOS_DIAGONAL(-d, -d);
+    JPS_ADDPOS_CHECK   ( 0, -d);
+    JPS_ADDPOS_DIAGONAL(+d, -d);
+    JPS_ADDPOS_CHECK   (-d,  0);
+    JPS_ADDPOS_CHECK   (+d,  0);
+    JPS_ADDPOS_DIAGONAL(-d, +d);
+    JPS_ADDPOS_CHECK   ( 0, +d);
+    JPS_ADDPOS_DIAGONAL(+d, +d);
+    stepsDone += 8;
+    stepsRemain -= 8;
+    return unsigned(w - wptr);
+}
+
+//-------------------------------------------------
+#undef JPS_ADDPOS
+#undef JPS_ADDPOS_CHECK
+#undef JPS_ADDPOS_NO_TUNNEL
+#undef JPS_ADDPOS_DIAGONAL
+#undef JPS_CHECKGRID
+
+
+template <typename GRID, typename NODEMAP, typename OPENLIST, typename POLICY> inline bool Searcher<GRID, NODEMAP, OPENLIST, POLICY>::canStepDiagonal(PosType x, PosType y, int dx, int dy) const
+{
+    return CanStepDiagonal<POLICY>(grid, x, y, dx, dy);
+}
+
+template <typename GRID, typename NODEMAP, typename OPENLIST, typename POLICY> bool Searcher<GRID, NODEMAP, OPENLIST, POLICY>::identifySuccessors(const Node& n)
+{
+    // Pick the specialized loop; this is only a runtime check with Expand_Flags
+    if(POLICY::expansion == Expand_JPS)
+        return identifySuccessors(n, BoolConst<false>());
+    if(POLICY::expansion == Expand_AStar || (flags & JPS_Flag_AStarOnly))
+        return identifySuccessors(n, BoolConst<true>());
+    return identifySuccessors(n, BoolConst<false>());
+}
+
+template <typename GRID, typename NODEMAP, typename OPENLIST, typename POLICY> template<bool ASTAR> bool Searcher<GRID, NODEMAP, OPENLIST, POLICY>::identifySuccessors(const Node& n_, BoolConst<ASTAR>)
+{
+    const SizeT nidx = storage.getindex(&n_);
+    const Position np = n_.pos;
+    Position buf[8];
+
+    const int num = ASTAR
+        ? findNeighborsAStar(n_, &buf[0])
+        : findNeighborsJPS(n_, &buf[0]);
+
+    for(int i = num-1; i >= 0; --i)
+    {
+        if(goalbounds && !goalbounds->mayReach(np, Sgn<int>(buf[i].x - np.x), Sgn<int>(buf[i].y - np.y), endPos))
+            continue;
+
+        // Invariant: A node is only a valid neighbor if the corresponding grid position is walkable (asserted in jumpP)
+        Position jp;
+        if(ASTAR)
+            jp = buf[i];
+        else
+        {
+            jp = jumpP(buf[i], np);
+            if(!jp.isValid())
+                continue;
+        }
+        // Now that the grid position is definitely a valid jump point, we have to create the actual node.
+        Node *jn = getNode(jp); // this might realloc the storage
+        if(!jn)
+            return false; // out of memory
+
+        Node& n = storage[nidx]; // get valid ref in case we realloc'd
+        JPS_ASSERT(jn != &n);
+        if(!jn->isClosed())
+            _expandNode(jp, *jn, n);
+        else if(anytimeStep)
+            _improveClosed(jp, *jn, n);
+    }
+    return true;
+}
+
+template <typename GRID, typename NODEMAP, typename OPENLIST, typename POLICY> template<typename PV> bool Searcher<GRID, NODEMAP, OPENLIST, POLICY>::findPath(PV& path, Position start, Position end, unsigned step, JPS_Flags flags)
+{
+    JPS_Result res = findPathInit(start, end, flags);
+
+    // If this is true, the resulting path is empty (findPathFinish() would fail, so this needs to be checked before)
+    if(res == JPS_EMPTY_PATH)
+        return true;
+
+    while(true)
+    {
+        switch(res)
+        {
+            case JPS_NEED_MORE_STEPS:
+                res = findPathStep(0);
+                break; // the switch
+
+            case JPS_FOUND_PATH:
+                return findPathFinish(path, step) == JPS_FOUND_PATH;
+
+            case JPS_EMPTY_PATH:
+                JPS_ASSERT(false); // can't happen
+                // fall through
+            case JPS_NO_PATH:
+            case JPS_OUT_OF_MEMORY:
+                return false;
+        }
+    }
+}
+
+template <typename GRID, typename NODEMAP, typename OPENLIST, typename POLICY> JPS_Result Searcher<GRID, NODEMAP, OPENLIST, POLICY>::findPathInit(Position start, Position end, JPS_Flags flags)
+{
+    // This just resets a few counters; container memory isn't touched
+    this->clear();
+
+    this->flags = flags;
+    endPos = end;
+    curWeight = weight;
+    found = false;
+    fromGoals = false;
+
+    // FIXME: check this
+    if(start == end && !(flags & (JPS_Flag_NoStartCheck|JPS_Flag_NoEndCheck)))
+    {
+        // There is only a path if this single position is walkable.
+        // But since the starting position is omitted in the output, there is nothing to do here.
+        return grid(end.x, end.y) ? JPS_EMPTY_PATH : JPS_NO_PATH;
+    }
+
+    if(!(flags & JPS_Flag_NoStartCheck))
+        if(!grid(start.x, start.y))
+            return JPS_NO_PATH;
+
+    if(!(flags & JPS_Flag_NoEndCheck))
+        if(!grid(end.x, end.y))
+            return JPS_NO_PATH;
+
+    // Both positions are known to be walkable here, unless the caller said otherwise
+    if(components && !(flags & (JPS_Flag_NoStartCheck|JPS_Flag_NoEndCheck)))
+        if(!components->connected(start, end))
+            return JPS_NO_PATH;
+
+    Node *endNode = getNode(end); // this might realloc the internal storage...
+    if(!endNode)
+        return JPS_OUT_OF_MEMORY;
+    endNodeIdx = storage.getindex(endNode); // .. so we keep this for later
+
+    Node *startNode = getNode(start); // this might also realloc
+    if(!startNode)
+        return JPS_OUT_OF_MEMORY;
+    endNode = &storage[endNodeIdx]; // startNode is valid, make sure that endNode is valid too in case we reallocated
+
+    if(!(flags & JPS_Flag_NoGreedy))
+    {
+        // Try the quick way out first
+        if(findPathGreedy(startNode, endNode))
+        {
+            curWeight = 100; // a direct line can't be improved on
+            found = true;
+            return JPS_FOUND_PATH;
+        }
+    }
+
+    startNode->setOpen(); // has its final g already; also makes sure nothing ever changes that
+    open.pushNode(startNode);
+
+    return JPS_NEED_MORE_STEPS;
+}
+
+template <typename GRID, typename NODEMAP, typename OPENLIST, typename POLICY> JPS_Result Searcher<GRID, NODEMAP, OPENLIST, POLICY>::findPathStep(int limit)
+{
+    stepsRemain = limit;
+    if(!anytimeStep)
+    {
+        do
+        {
+            if(open.empty())
+                return JPS_NO_PATH;
+            Node& n = open.popNode();
+            n.setClosed();
+            if(n.pos == endPos)
+                return JPS_FOUND_PATH;
+            if(!identifySuccessors(n))
+                return JPS_OUT_OF_MEMORY;
+        }
+        while(stepsRemain >= 0);
+        return JPS_NEED_MORE_STEPS;
+    }
+
+    // Anytime search. A round ends when the path to the end can't get shorter by more than the current weight allows.
+    if(found)
+    {
+        if(curWeight == 100)
+            return JPS_FOUND_PATH; // optimal already
+        _nextRound();
+    }
+    do
+    {
+        if(open.empty())
+            break;
+        Node& n = open.popNode();
+        const Node& endNode = storage[endNodeIdx]; // storage may have been realloc'd
+        if(endNode.isOpen() && n.f >= endNode.g)
+        {
+            open.pushNode(&n); // for the next round
+            break;
+        }
+        n.setClosed();
+        if(n.pos == endPos)
+            break;
+        if(!identifySuccessors(n))
+            return JPS_OUT_OF_MEMORY;
+        if(stepsRemain < 0)
+            return JPS_NEED_MORE_STEPS;
+    }
+    while(true);
+    if(!storage[endNodeIdx].isOpen())
+        return JPS_NO_PATH;
+    found = true;
+    return JPS_FOUND_PATH;
+}
+
+// Anytime: Lower the weight, then continue with all nodes that were open or got a shorter path, with f updated.
+template <typename GRID, typename NODEMAP, typename OPENLIST, typename POLICY> void Searcher<GRID, NODEMAP, OPENLIST, POLICY>::_nextRound()
+{
+    curWeight = curWeight > 100 + anytimeStep ? curWeight - anytimeStep : 100;
+    found = false;
+    open.clear();
+    for(SizeT i = 0; i < storage.size(); ++i)
+    {
+        Node& n = storage[i];
+        if(!n.isOpen())
+            continue;
+        if((!n.isClosed() && !n.isIdle()) || n.isIncons())
+        {
+            n.reopen();
+            n.f = n.g + _estimate(n.pos);
+            open.pushNode(&n);
+        }
+        else
+            n.setIdle(); // no longer closed, but not in the open list either
+    }
+}
+
+template <typename GRID, typename NODEMAP, typename OPENLIST, typename POLICY> template<typename PV> JPS_Result Searcher<GRID, NODEMAP, OPENLIST, POLICY>::findPathFinish(PV& path, unsigned step) const
+{
+    return fromGoals ? this->generatePathToRoot(path, step, endNodeIdx) : this->generatePath(path, step);
+}
+
+template <typename GRID, typename NODEMAP, typename OPENLIST, typename POLICY> template<typename PV> bool Searcher<GRID, NODEMAP, OPENLIST, POLICY>::findPathToNearest(PV& path, Position start, const Position *goals, SizeT n, unsigned step, JPS_Flags flags)
+{
+    JPS_Result res = findPathInitNearest(start, goals, n, flags);
+    if(res == JPS_EMPTY_PATH)
+        return true;
+    while(res == JPS_NEED_MORE_STEPS)
+        res = findPathStep(0);
+    return res == JPS_FOUND_PATH && findPathFinish(path, step) == JPS_FOUND_PATH;
+}
+
+template <typename GRID, typename NODEMAP, typename OPENLIST, typename POLICY> bool Searcher<GRID, NODEMAP, OPENLIST, POLICY>::findCostsToMany(Position start, const Position *targets, SizeT n, ScoreType *costs, JPS_Flags flags)
+{
+    this->clear();
+    this->flags = flags;
+    endPos = npos;
+    curWeight = 100;
+    found = false;
+    fromGoals = false;
+
+    for(SizeT i = 0; i < n; ++i)
+        costs[i] = noscore;
+    if(!(flags & JPS_Flag_NoStartCheck))
+        if(!grid(start.x, start.y))
+            return true;
+    Node *sn = getNode(start);
+    if(!sn)
+        return false;
+    sn->setOpen();
+    open.pushNode(sn);
+
+    // Goal bounds only hold for one end position
+    const GoalBounds * const gb = goalbounds;
+    goalbounds = 0;
+    bool ok = true;
+    for(SizeT i = 0; ok && i < n; ++i)
+    {
+        const Position t = targets[i];
+        if(!(flags & JPS_Flag_NoEndCheck))
+        {
+            if(!grid(t.x, t.y))
+                continue;
+            if(components && !(flags & JPS_Flag_NoStartCheck) && !components->connected(start, t))
+                continue;
+        }
+        const Node *tn = nodemap.find(t.x, t.y);
+        if(!(tn && tn->isClosed()) && !open.empty())
+        {
+            // Closed nodes have their final g no matter which end the estimate was for,
+            // so only the open list needs to be sorted for the new end
+            endPos = t;
+            open.clear();
+            for(SizeT k = 0; k < storage.size(); ++k)
+            {
+                Node& m = storage[k];
+                if(m.isOpen() && !m.isClosed())
+                {
+                    m.f = m.g + _estimate(m.pos);
+                    open.pushNode(&m);
+                }
+            }
+            while(!open.empty())
+            {
+                Node& m = open.popNode();
+                m.setClosed();
+                const bool done = m.pos == t; // still needs to be expanded for the next targets
+                if(!identifySuccessors(m, BoolConst<true>()))
+                {
+                    ok = false;
+                    break;
+                }
+                if(done)
+                    break;
+            }
+            tn = nodemap.find(t.x, t.y);
+        }
+        if(tn && tn->isClosed())
+            costs[i] = tn->g;
+    }
+    goalbounds = gb;
+    return ok;
+}
+
+template <typename GRID, typename NODEMAP, typename OPENLIST, typename POLICY> template<typename PV> JPS_Result Searcher<GRID, NODEMAP, OPENLIST, POLICY>::findPathFinishTo(PV& path, Position target, unsigned step) const
+{
+    const Node *n = nodemap.find(target.x, target.y);
+    if(!n || !n->isClosed())
+        return JPS_NO_PATH;
+    if(!n->hasParent())
+        return JPS_EMPTY_PATH;
+    return this->generatePath(path, step, storage.getindex(n));
+}
+
+// The grid is undirected, so searching from the goals to the start finds the same paths backwards.
+// This way, all goals are simply start nodes, and the start is the only end: Jumps, estimate, goal bounds
+// and component checks work as usual. The first time the start is popped, it came from the nearest goal.
+template <typename GRID, typename NODEMAP, typename OPENLIST, typename POLICY> JPS_Result Searcher<GRID, NODEMAP, OPENLIST, POLICY>::findPathInitNearest(Position start, const Position *goals, SizeT n, JPS_Flags flags)
+{
+    this->clear();
+
+    this->flags = flags;
+    endPos = start;
+    curWeight = weight;
+    found = false;
+    fromGoals = true;
+
+    if(!(flags & JPS_Flag_NoStartCheck))
+        if(!grid(start.x, start.y))
+            return JPS_NO_PATH;
+
+    Node *endNode = getNode(start);
+    if(!endNode)
+        return JPS_OUT_OF_MEMORY;
+    endNodeIdx = storage.getindex(endNode);
+
+    for(SizeT i = 0; i < n; ++i)
+    {
+        const Position g = goals[i];
+        if(g == start)
+            return JPS_EMPTY_PATH;
+        if(!(flags & JPS_Flag_NoEndCheck))
+        {
+            if(!grid(g.x, g.y))
+                continue;
+            if(components && !(flags & JPS_Flag_NoStartCheck) && !components->connected(start, g))
+                continue;
+        }
+        Node *gn = getNode(g);
+        if(!gn)
+            return JPS_OUT_OF_MEMORY;
+        if(gn->isOpen())
+            continue; // listed twice
+        gn->f = _estimate(g);
+        gn->setOpen();
+        open.pushNode(gn);
+    }
+
+    return open.empty() ? JPS_NO_PATH : JPS_NEED_MORE_STEPS;
+}
+
+template <typename GRID, typename NODEMAP, typename OPENLIST, typename POLICY> bool Searcher<GRID, NODEMAP, OPENLIST, POLICY>::_flood(Position start)
+{
+    this->clear();
+    this->flags = 0;
+    endPos = npos;
+    curWeight = 100;
+    Node *n = getNode(start);
+    if(!n)
+        return false;
+    n->setOpen();
+    open.pushNode(n);
+    while(!open.empty())
+    {
+        Node& c = open.popNode();
+        c.setClosed();
+        if(!identifySuccessors(c))
+            return false;
+    }
+    return true;
+}
+
+template <typename GRID, typename NODEMAP, typename OPENLIST, typename POLICY> bool Searcher<GRID, NODEMAP, OPENLIST, POLICY>::findPathGreedy(Node *n, Node *endnode)
+{
+    Position midpos = npos;
+    PosType x = n->pos.x;
+    PosType y = n->pos.y;
+    const Position endpos = endnode->pos;
+
+    JPS_ASSERT(x != endpos.x || y != endpos.y); // must not be called when start==end
+    JPS_ASSERT(n != endnode);
+
+    int dx = int(endpos.x - x);
+    int dy = int(endpos.y - y);
+    const int adx = Abs(dx);
+    const int ady = Abs(dy);
+    dx = Sgn(dx);
+    dy = Sgn(dy);
+
+    // go diagonally first
+    if(x != endpos.x && y != endpos.y)
+    {
+        JPS_ASSERT(dx && dy);
+        const int minlen = Min(adx, ady);
+        const PosType tx = x + dx * minlen;
+        while(x != tx)
+        {
+            if(grid(x, y) && canStepDiagonal(x, y, dx, dy)) // obey the diagonal rule as well
+            {
+                x += dx;
+                y += dy;
+            }
+            else
+                return false;
+        }
+
+        if(!grid(x, y))
+            return false;
+
+        midpos = Pos(x, y);
+    }
+
+    // at this point, we're aligned to at least one axis
+    JPS_ASSERT(x == endpos.x || y == endpos.y);
+
+    if(!(x == endpos.x && y == endpos.y))
+    {
+        while(x != endpos.x)
+            if(!grid(x += dx, y))
+                return false;
+
+        while(y != endpos.y)
+            if(!grid(x, y += dy))
+                return false;
+
+        JPS_ASSERT(x == endpos.x && y == endpos.y);
+    }
+
+    if(midpos.isValid())
+    {
+        const unsigned nidx = storage.getindex(n);
+        Node *mid = getNode(midpos); // this might invalidate n, endnode
+        if(!mid)
+            return false;
+        n = &storage[nidx]; // reload pointers
+        endnode = &storage[endNodeIdx];
+        JPS_ASSERT(mid && mid != n);
+        mid->setParent(*n);
+        if(mid != endnode)
+            endnode->setParent(*mid);
+    }
+    else
+        endnode->setParent(*n);
+
+    return true;
+}
+
+// -----------------------------------------------------------------------
+
+// A grid that only lets through one rectangle [x0, x1) x [y0, y1) of another grid.
+template <typename GRID>
+struct ClusterGrid
+{
+    const GRID& grid;
+    PosType x0, y0, x1, y1;
+
+    ClusterGrid(const GRID& g)
+        : grid(g), x0(0), y0(0), x1(0), y1(0)
+    {}
+
+    inline bool operator()(PosType x, PosType y) const
+    {
+        return x - x0 < x1 - x0 && y - y0 < y1 - y0 && grid(x, y); // unsigned, so this also rejects x < x0
+    }
+};
+
+// Hierarchical search (HPA*) for very large grids.
+// The grid is split into square clusters. Where two clusters touch, each run of cells that is walkable on both sides
+// gets an entrance (two if the run is long), and the costs between all entrances of a cluster are precomputed with
+// Searchers that can't leave the cluster. A query connects start and end to the entrances of their clusters,
+// searches that small graph of entrances, then refines each of its steps with a search inside one cluster.
+// So the work per query depends on the number of clusters along the way, not on the number of cells.
+// Paths can only go from one cluster to another via entrances, so they are usually a few percent longer than the shortest one.
+// On grids of a few 100k cells, a plain Searcher is about as fast; this pays off on grids with millions of cells.
+// After changing the grid, call update() for each changed cell; the clusters around it are rebuilt on the next query.
+template <typename GRID, typename POLICY = SearchPolicy<> >
+class HierSearcher
 {
 public:
-    Searcher(const GRID& g, void *user = 0)
-        : SearcherBase(user), grid(g)
+    HierSearcher(const GRID& g, void *user = 0)
+        : grid(g), _view(g), _local(_view, user), _fill(_view, user)
+        , _ents(user), _first(user), _distOffs(user), _dist(user), _dirty(user)
+        , _nodes(user), _open(_nodes), _touched(user), _startCost(user), _endCost(user), _abs(user)
+        , _w(0), _h(0), _cw(0), _ch(0), _cs(0), _anyDirty(false)
+        , _start(npos), _end(npos), _flags(0), _next(0)
     {}
 
+    // Build the graph for a grid of w * h cells. Returns false if out of memory.
+    // Small clusters make for more entrances, large clusters for more expensive searches inside of them.
+    bool init(PosType w, PosType h, unsigned clusterSize = 32)
+    {
+        JPS_ASSERT(clusterSize >= 2);
+        dealloc();
+        _w = w;
+        _h = h;
+        _cs = clusterSize;
+        _cw = (w + clusterSize - 1) / clusterSize;
+        _ch = (h + clusterSize - 1) / clusterSize;
+        _local.getNodeMap().init(clusterSize, clusterSize);
+        _fill.getNodeMap().init(clusterSize, clusterSize);
+        const SizeT nc = SizeT(_cw) * _ch;
+        _dirty.resize(nc);
+        if(_dirty.size() != nc)
+        {
+            dealloc();
+            return false;
+        }
+        for(SizeT i = 0; i < nc; ++i)
+            _dirty[i] = 1;
+        _anyDirty = true;
+        return repair();
+    }
+
+    // Call after cell (x, y) of the grid was changed. Cheap; the actual work happens in repair().
+    void update(PosType x, PosType y)
+    {
+        JPS_ASSERT(x < _w && y < _h);
+        const PosType cx = x / _cs, cy = y / _cs;
+        _setDirty(cx, cy);
+        // Cells on the edge of a cluster decide about the entrances of the neighbor, too
+        if(cx && x % _cs == 0)
+            _setDirty(cx - 1, cy);
+        if(cx + 1 < _cw && x % _cs == _cs - 1)
+            _setDirty(cx + 1, cy);
+        if(cy && y % _cs == 0)
+            _setDirty(cx, cy - 1);
+        if(cy + 1 < _ch && y % _cs == _cs - 1)
+            _setDirty(cx, cy + 1);
+    }
+
+    // Rebuild the clusters marked by update(); the others are kept as they are. Called by findPathInit().
+    // Returns false if out of memory, in which case everything stays dirty.
+    bool repair();
+
+    void dealloc()
+    {
+        freeMemory();
+        _ents.dealloc();
+        _first.dealloc();
+        _distOffs.dealloc();
+        _dist.dealloc();
+        _dirty.dealloc();
+        _w = _h = _cw = _ch = 0;
+        _anyDirty = false;
+    }
+
+    // Frees memory used by queries only, the graph is kept.
+    void freeMemory()
+    {
+        _local.freeMemory();
+        _fill.freeMemory();
+        _nodes.dealloc();
+        _open.dealloc();
+        _touched.dealloc();
+        _startCost.dealloc();
+        _endCost.dealloc();
+        _abs.dealloc();
+        _next = 0;
+    }
+
     // single-call
     template<typename PV>
     bool findPath(PV& path, Position start, Position end, unsigned step, JPS_Flags flags = JPS_Flag_Default);
 
-    // incremental pathfinding
+    // Finds the sequence of entrances to go through. Never returns JPS_NEED_MORE_STEPS.
     JPS_Result findPathInit(Position start, Position end, JPS_Flags flags = JPS_Flag_Default);
-    JPS_Result findPathStep(int limit);
-    // generate path after one was found
+
+    // Appends the path for the next 'segments' parts of that sequence, or all of them if 0.
+    // Returns JPS_NEED_MORE_STEPS while parts are left; call again to get the rest.
+    // That way, only the first few clusters need to be searched before one can start moving.
     template<typename PV>
-    JPS_Result findPathFinish(PV& path, unsigned step) const;
+    JPS_Result findPathFinish(PV& path, unsigned step, unsigned segments = 0);
+
+    // The sequence of entrances found by findPathInit(), followed by the end
+    SizeT getAbstractPathLength() const { return _abs.size(); }
+    Position getAbstractWaypoint(SizeT i) const { return _nodes[_abs[i]].pos; }
+
+    inline SizeT getNumEntrances() const { return _ents.size(); }
+
+    // The graph, e.g. for debugging. Entrances are sorted by cluster.
+    inline Position getEntrance(SizeT i) const { return _ents[i].pos; }
+    // Cost from entrance i to entrance k inside of their cluster. noscore if k is in another cluster or can't be reached.
+    ScoreType getEntranceCost(SizeT i, SizeT k) const
+    {
+        const SizeT c = _ents[i].cluster, base = _first[c], cnt = _first[c + 1] - base;
+        return k - base < cnt ? _dist[_distOffs[c] + (i - base) * cnt + (k - base)] : noscore; // unsigned, so this also rejects k < base
+    }
+
+    SizeT getTotalMemoryInUse() const
+    {
+        return _local.getTotalMemoryInUse() + _fill.getTotalMemoryInUse()
+             + _ents._getMemSize() + _first._getMemSize() + _distOffs._getMemSize() + _dist._getMemSize() + _dirty._getMemSize()
+             + _nodes._getMemSize() + _open._getMemSize() + _touched._getMemSize()
+             + _startCost._getMemSize() + _endCost._getMemSize() + _abs._getMemSize();
+    }
 
 private:
 
+    struct Entrance
+    {
+        Position pos;
+        SizeT cluster;
+        SizeT partner; // entrance on the other side of the border
+        unsigned dir;  // border it's on: 0 left, 1 top, 2 right, 3 bottom
+    };
+
+    typedef SearchPolicy<Heuristic::NoEstimate<typename POLICY::Costs>, Expand_AStar, POLICY::diagonal> FillPolicy;
+
     const GRID& grid;
+    ClusterGrid<GRID> _view;
+    Searcher<ClusterGrid<GRID>, DenseNodeMap, OpenList, POLICY> _local;    // paths inside of _view
+    Searcher<ClusterGrid<GRID>, DenseNodeMap, OpenList, FillPolicy> _fill; // costs from one position to all others in _view
+
+    // The graph. Entrances are sorted by cluster.
+    PodVec<Entrance> _ents;
+    PodVec<SizeT> _first;         // per cluster: index of its first entrance; one extra at the end
+    PodVec<SizeT> _distOffs;      // per cluster: where its n * n costs between its n entrances start in _dist
+    PodVec<ScoreType> _dist;      // noscore if not reachable inside of the cluster
+    PodVec<unsigned char> _dirty; // per cluster
+
+    // Query. Nodes are the entrances, then start and end.
+    Storage _nodes;
+    OpenList _open;
+    PodVec<SizeT> _touched;       // nodes to reset before the next query
+    PodVec<ScoreType> _startCost; // from the start to each entrance of its cluster
+    PodVec<ScoreType> _endCost;   // from each entrance of the end's cluster to the end
+    PodVec<SizeT> _abs;           // nodes on the path, without the start
+
+    PosType _w, _h, _cw, _ch;
+    unsigned _cs;
+    bool _anyDirty;
+    Position _start, _end;
+    JPS_Flags _flags;
+    SizeT _next; // index into _abs of the next part to refine
+
+    inline void _setDirty(PosType cx, PosType cy)
+    {
+        _dirty[SizeT(cy) * _cw + cx] = 1;
+        _anyDirty = true;
+    }
 
-    Node *getNode(const Position& pos);
-    bool identifySuccessors(const Node& n);
+    inline SizeT _clusterOf(const Position& p) const { return SizeT(p.y / _cs) * _cw + p.x / _cs; }
 
-    bool findPathGreedy(Node *start, Node *end);
-    
-    unsigned findNeighborsAStar(const Node& n, Position *wptr);
+    void _setView(SizeT c)
+    {
+        _view.x0 = PosType(c % _cw) * _cs;
+        _view.y0 = PosType(c / _cw) * _cs;
+        _view.x1 = Min<PosType>(_view.x0 + _cs, _w);
+        _view.y1 = Min<PosType>(_view.y0 + _cs, _h);
+        _local.getNodeMap().setOrigin(_view.x0, _view.y0);
+        _fill.getNodeMap().setOrigin(_view.x0, _view.y0);
+    }
 
-    unsigned findNeighborsJPS(const Node& n, Position *wptr) const;
-    Position jumpP(const Position& p, const Position& src);
-    Position jumpD(Position p, int dx, int dy);
-    Position jumpX(Position p, int dx);
-    Position jumpY(Position p, int dy);
+    void _borderEntrances(PosType cx, PosType cy, bool vertical, PodVec<PosType>& out) const;
+    bool _addEntrances(SizeT c, PodVec<Entrance>& ents, PodVec<PosType>& tmp) const;
+    bool _connect(const Position& p, SizeT c, PodVec<ScoreType>& cost);
+    bool _resetNodes();
+    bool _relax(Node& n, SizeT to, ScoreType cost);
 
-    // forbid any ops
-    Searcher& operator=(const Searcher<GRID>&);
-    Searcher(const Searcher<GRID>&);
+    // forbid ops
+    HierSearcher& operator=(const HierSearcher&);
+    HierSearcher(const HierSearcher&);
 };
 
+// Positions of the entrances along the border between cluster (cx, cy) and its neighbor to the right (vertical)
+// or below (!vertical), as coordinate along that border. Long runs get one entrance at each end, short ones one in the middle.
+template <typename GRID, typename POLICY> void HierSearcher<GRID, POLICY>::_borderEntrances(PosType cx, PosType cy, bool vertical, PodVec<PosType>& out) const
+{
+    const PosType fixed = (vertical ? cx + 1 : cy + 1) * _cs - 1;
+    const PosType lo = (vertical ? cy : cx) * _cs;
+    const PosType hi = Min<PosType>(lo + _cs, vertical ? _h : _w);
+    const PosType none = PosType(-1);
+    PosType runStart = none;
+    for(PosType i = lo; i <= hi; ++i)
+    {
+        const bool ok = i < hi && (vertical
+            ? grid(fixed, i) && grid(fixed + 1, i)
+            : grid(i, fixed) && grid(i, fixed + 1));
+        if(ok)
+        {
+            if(runStart == none)
+                runStart = i;
+        }
+        else if(runStart != none)
+        {
+            const PosType len = i - runStart;
+            if(len < 6)
+                out.push_back(runStart + len / 2);
+            else
+            {
+                out.push_back(runStart);
+                out.push_back(i - 1);
+            }
+            runStart = none;
+        }
+    }
+}
 
-// -----------------------------------------------------------------------
+// Append the entrances of cluster c, in the order left, top, right, bottom. Partners are set later.
+template <typename GRID, typename POLICY> bool HierSearcher<GRID, POLICY>::_addEntrances(SizeT c, PodVec<Entrance>& ents, PodVec<PosType>& tmp) const
+{
+    const PosType cx = PosType(c % _cw), cy = PosType(c / _cw);
+    const PosType x0 = cx * _cs, y0 = cy * _cs;
+    for(unsigned dir = 0; dir < 4; ++dir)
+    {
+        tmp.clear();
+        Position p;
+        switch(dir)
+        {
+            case 0: if(!cx) continue;           _borderEntrances(cx - 1, cy, true, tmp);  p = Pos(x0, 0); break;
+            case 1: if(!cy) continue;           _borderEntrances(cx, cy - 1, false, tmp); p = Pos(0, y0); break;
+            case 2: if(cx + 1 >= _cw) continue; _borderEntrances(cx, cy, true, tmp);      p = Pos(x0 + _cs - 1, 0); break;
+            case 3: if(cy + 1 >= _ch) continue; _borderEntrances(cx, cy, false, tmp);     p = Pos(0, y0 + _cs - 1); break;
+        }
+        for(SizeT i = 0; i < tmp.size(); ++i)
+        {
+            Entrance *e = ents.alloc();
+            if(!e)
+                return false;
+            e->pos = (dir & 1) ? Pos(tmp[i], p.y) : Pos(p.x, tmp[i]);
+            e->cluster = c;
+            e->partner = noidx;
+            e->dir = dir;
+        }
+    }
+    return true;
+}
 
-template<typename PV> JPS_Result SearcherBase::generatePath(PV& path, unsigned step) const
+template <typename GRID, typename POLICY> bool HierSearcher<GRID, POLICY>::repair()
 {
-    if(endNodeIdx == noidx)
-        return JPS_NO_PATH;
-    const SizeT offset = path.size();
-    SizeT added = 0;
-    const Node& endNode = storage[endNodeIdx];
-    const Node *next = &endNode;
-    if(!next->hasParent())
-        return JPS_NO_PATH;
-    if(step)
+    if(!_anyDirty)
+        return true;
+
+    // Build the new graph next to the old one, copying what's still valid
+    void * const user = _ents._user;
+    const SizeT nc = SizeT(_cw) * _ch;
+    PodVec<Entrance> ents(user);
+    PodVec<SizeT> first(user), offs(user);
+    PodVec<ScoreType> dist(user);
+    PodVec<PosType> tmp(user);
+    first.resize(nc + 1);
+    offs.resize(nc + 1);
+    if(first.size() != nc + 1 || offs.size() != nc + 1)
+        return false;
+
+    for(SizeT c = 0; c < nc; ++c)
     {
-        const Node *prev = endNode.getParentOpt();
-        if(!prev)
-            return JPS_NO_PATH;
-        do
+        first[c] = ents.size();
+        if(_dirty[c])
         {
-            const unsigned x = next->pos.x, y = next->pos.y;
-            int dx = int(prev->pos.x - x);
-            int dy = int(prev->pos.y - y);
-            const int adx = Abs(dx);
-            const int ady = Abs(dy);
-            JPS_ASSERT(!dx || !dy || adx == ady); // known to be straight, if diagonal
-            const int steps = Max(adx, ady);
-            dx = int(step) * Sgn(dx);
-            dy = int(step) * Sgn(dy);
-            int dxa = 0, dya = 0;
-            for(int i = 0; i < steps; i += step)
+            if(!_addEntrances(c, ents, tmp))
+                return false;
+        }
+        else
+            for(SizeT i = _first[c]; i < _first[c+1]; ++i)
             {
-                path.push_back(Pos(x+dxa, y+dya));
-                ++added;
-                dxa += dx;
-                dya += dy;
+                ents.push_back(_ents[i]);
+                if(ents.size() != first[c] + (i - _first[c]) + 1)
+                    return false;
             }
-            next = prev;
-            prev = prev->getParentOpt();
+    }
+    first[nc] = ents.size();
+
+    // Borders between clean clusters haven't changed, but indices may have
+    for(SizeT i = 0; i < ents.size(); ++i)
+    {
+        Entrance& e = ents[i];
+        static const int dx[4] = { -1, 0, 1, 0 };
+        static const int dy[4] = { 0, -1, 0, 1 };
+        const Position p = Pos(e.pos.x + dx[e.dir], e.pos.y + dy[e.dir]);
+        const SizeT o = _clusterOf(p);
+        e.partner = noidx;
+        for(SizeT k = first[o]; k < first[o+1]; ++k)
+            if(ents[k].pos == p && ents[k].dir == ((e.dir + 2) & 3))
+            {
+                e.partner = k;
+                break;
+            }
+        JPS_ASSERT(e.partner != noidx); // both sides see the same border
+    }
+
+    for(SizeT c = 0; c < nc; ++c)
+    {
+        const SizeT n = first[c+1] - first[c];
+        const SizeT base = dist.size();
+        offs[c] = base;
+        dist.resize(base + n * n);
+        if(dist.size() != base + n * n)
+            return false;
+        if(!_dirty[c])
+        {
+            for(SizeT i = 0; i < n * n; ++i)
+                dist[base + i] = _dist[_distOffs[c] + i];
+            continue;
+        }
+        _setView(c);
+        for(SizeT i = 0; i < n; ++i)
+        {
+            dist[base + i * n + i] = 0;
+            if(i + 1 == n)
+                break;
+            if(!_fill._flood(ents[first[c] + i].pos))
+                return false;
+            for(SizeT k = i + 1; k < n; ++k) // costs are symmetric
+                dist[base + i * n + k] = dist[base + k * n + i] = _fill._reachedCost(ents[first[c] + k].pos);
+        }
+    }
+    offs[nc] = dist.size();
+    _nodes.clear(); // node positions are outdated
+
+    _ents.swap(ents);
+    _first.swap(first);
+    _distOffs.swap(offs);
+    _dist.swap(dist);
+    for(SizeT c = 0; c < nc; ++c)
+        _dirty[c] = 0;
+    _anyDirty = false;
+    return true;
+}
+
+// Costs between p and each entrance of cluster c; the same in both directions. Leaves _fill expanded from p.
+template <typename GRID, typename POLICY> bool HierSearcher<GRID, POLICY>::_connect(const Position& p, SizeT c, PodVec<ScoreType>& cost)
+{
+    const SizeT n = _first[c+1] - _first[c];
+    cost.resize(n);
+    _setView(c);
+    if(cost.size() != n || !_fill._flood(p))
+        return false;
+    for(SizeT i = 0; i < n; ++i)
+        cost[i] = _fill._reachedCost(_ents[_first[c] + i].pos);
+    return true;
+}
+
+// Only the nodes used by the last query need to be reset, unless the graph changed
+template <typename GRID, typename POLICY> bool HierSearcher<GRID, POLICY>::_resetNodes()
+{
+    const SizeT n = _ents.size() + 2;
+    if(_nodes.size() != n)
+    {
+        _nodes.resize(n);
+        if(_nodes.size() != n)
+            return false;
+        for(SizeT i = 0; i < n - 2; ++i)
+            _nodes[i].pos = _ents[i].pos;
+        _touched.clear();
+        for(SizeT i = 0; i < n; ++i)
+            _touched.push_back(i);
+        if(_touched.size() != n)
+            return false;
+    }
+    for(SizeT i = 0; i < _touched.size(); ++i)
+    {
+        Node& m = _nodes[_touched[i]];
+        m.f = m.g = 0;
+        m.parentOffs = 0;
+        m._flags = 0;
+        m._heapIdx = noidx;
+    }
+    _touched.clear();
+    return true;
+}
+
+template <typename GRID, typename POLICY> bool HierSearcher<GRID, POLICY>::_relax(Node& n, SizeT to, ScoreType cost)
+{
+    Node& m = _nodes[to];
+    if(m.isClosed())
+        return true;
+    const ScoreType g = n.g + cost;
+    if(!m.isOpen() || g < m.g)
+    {
+        m.g = g;
+        m.f = g + POLICY::Costs::Estimate(m.pos, _end);
+        m.setParent(n);
+        if(!m.isOpen())
+        {
+            const SizeT sz = _touched.size();
+            _touched.push_back(to);
+            if(_touched.size() == sz)
+                return false;
+            m.setOpen();
+            _open.pushNode(&m);
+        }
+        else
+            _open.fixNode(m);
+    }
+    return true;
+}
+
+template <typename GRID, typename POLICY> template<typename PV> bool HierSearcher<GRID, POLICY>::findPath(PV& path, Position start, Position end, unsigned step, JPS_Flags flags)
+{
+    const JPS_Result res = findPathInit(start, end, flags);
+    if(res == JPS_EMPTY_PATH)
+        return true;
+    return res == JPS_FOUND_PATH && findPathFinish(path, step) == JPS_FOUND_PATH;
+}
+
+template <typename GRID, typename POLICY> JPS_Result HierSearcher<GRID, POLICY>::findPathInit(Position start, Position end, JPS_Flags flags)
+{
+    _abs.clear();
+    _next = 0;
+    _start = start;
+    _end = end;
+    _flags = flags;
+
+    if(!repair())
+        return JPS_OUT_OF_MEMORY;
+
+    if(start.x >= _w || start.y >= _h || end.x >= _w || end.y >= _h)
+        return JPS_NO_PATH;
+
+    if(start == end && !(flags & (JPS_Flag_NoStartCheck|JPS_Flag_NoEndCheck)))
+        return grid(end.x, end.y) ? JPS_EMPTY_PATH : JPS_NO_PATH;
+
+    if(!(flags & JPS_Flag_NoStartCheck))
+        if(!grid(start.x, start.y))
+            return JPS_NO_PATH;
+
+    if(!(flags & JPS_Flag_NoEndCheck))
+        if(!grid(end.x, end.y))
+            return JPS_NO_PATH;
+
+    const SizeT cs = _clusterOf(start), ce = _clusterOf(end);
+    const SizeT S = _ents.size(), E = S + 1;
+
+    if(!_connect(start, cs, _startCost) || !_connect(end, ce, _endCost) || !_resetNodes())
+        return JPS_OUT_OF_MEMORY;
+    // Staying inside of the cluster may be shorter than going via its entrances. _fill is still expanded from the end.
+    const ScoreType direct = cs == ce ? _fill._reachedCost(start) : noscore;
+
+    _nodes[S].pos = start;
+    _nodes[E].pos = end;
+    const SizeT used = _touched.size();
+    _touched.push_back(S);
+    _touched.push_back(E);
+    if(_touched.size() != used + 2)
+        return JPS_OUT_OF_MEMORY;
+    _open.clear();
+    _nodes[S].setOpen();
+    _open.pushNode(&_nodes[S]);
+    while(!_open.empty())
+    {
+        Node& n = _open.popNode();
+        n.setClosed();
+        const SizeT i = _nodes.getindex(&n);
+        if(i == E)
+        {
+            SizeT len = 0;
+            for(const Node *p = &n; p != &_nodes[S]; p = &p->getParent(), ++len)
+                _abs.push_back(_nodes.getindex(p));
+            if(_abs.size() != len)
+                return JPS_OUT_OF_MEMORY;
+            Reverse(_abs.begin(), _abs.end());
+            return JPS_FOUND_PATH;
+        }
+        bool ok = true;
+        if(i == S)
+        {
+            for(SizeT k = 0; k < _startCost.size(); ++k)
+                if(_startCost[k] != noscore)
+                    ok = _relax(n, _first[cs] + k, _startCost[k]) && ok;
+            if(direct != noscore)
+                ok = _relax(n, E, direct) && ok;
+        }
+        else
+        {
+            const Entrance& e = _ents[i];
+            const SizeT base = _first[e.cluster], cnt = _first[e.cluster + 1] - base, li = i - base;
+            const ScoreType *row = &_dist[_distOffs[e.cluster] + li * cnt];
+            for(SizeT k = 0; k < cnt; ++k)
+                if(k != li && row[k] != noscore)
+                    ok = _relax(n, base + k, row[k]) && ok;
+            ok = _relax(n, e.partner, POLICY::Costs::Cost(e.pos, _ents[e.partner].pos)) && ok;
+            if(e.cluster == ce && _endCost[li] != noscore)
+                ok = _relax(n, E, _endCost[li]) && ok;
+        }
+        if(!ok)
+            return JPS_OUT_OF_MEMORY;
+    }
+    return JPS_NO_PATH;
+}
+
+template <typename GRID, typename POLICY> template<typename PV> JPS_Result HierSearcher<GRID, POLICY>::findPathFinish(PV& path, unsigned step, unsigned segments)
+{
+    const SizeT S = _ents.size(), E = S + 1;
+    for(unsigned done = 0; _next < _abs.size() && (!segments || done < segments); ++_next, ++done)
+    {
+        const SizeT from = _next ? _abs[_next - 1] : S, to = _abs[_next];
+        const Position a = _nodes[from].pos, b = _nodes[to].pos;
+        if(a == b)
+            continue; // the same cell can be an entrance on two borders
+        if(from != S && _ents[from].partner == to)
+        {
+            path.push_back(b); // crossing the border is a single straight step
+            continue;
+        }
+        // Everything else stays inside of one cluster
+        _setView(from != S ? _ents[from].cluster : to != E ? _ents[to].cluster : _clusterOf(_start));
+        JPS_Flags f = _flags;
+        if(from != S)
+            f &= ~JPS_Flag_NoStartCheck;
+        if(to != E)
+            f &= ~JPS_Flag_NoEndCheck;
+        if(!_local.findPath(path, a, b, step, f))
+            return JPS_NO_PATH; // grid changed without update()?
+    }
+    return _next < _abs.size() ? JPS_NEED_MORE_STEPS : JPS_FOUND_PATH;
+}
+
+// Incremental replanning (D* Lite) for grids that change while a path is being followed.
+// Searches backwards, from the end to the start, and keeps its state afterwards. So when the start moves along the path,
+// nothing needs to be recomputed, and when cells change, notifyCellChanged() fixes the costs right around them;
+// the next findPathStep() then only expands the nodes whose cost to the end actually changed.
+// Uses plain A* expansion (no jumps), since the costs of all cells near the path are needed.
+// The estimate must never overestimate (hence the default policy); otherwise, repaired paths may be longer than necessary.
+// Typical use:
+//   findPathInit(start, end), findPathStep() until it returns JPS_FOUND_PATH, findPathFinish(path, step).
+//   While following the path: moveStart() as the start moves; notifyCellChanged() after changing the grid.
+//   Then findPathStep() and findPathFinish() again to get the repaired path.
+template <typename GRID, typename POLICY = SearchPolicy<Heuristic::OctileCosts, Expand_AStar> >
+class ReplanSearcher
+{
+public:
+    ReplanSearcher(const GRID& g, void *user = 0)
+        : grid(g), storage(user), nodemap(storage), open(storage), _rhs(user)
+        , _start(npos), _last(npos), _end(npos), _km(0), _startIdx(noidx), _expanded(0)
+    {}
+
+    void freeMemory()
+    {
+        storage.dealloc();
+        nodemap.dealloc();
+        open.dealloc();
+        _rhs.dealloc();
+        _end = npos;
+        _startIdx = noidx;
+    }
+
+    // single-call. Keeps the search state if end is the same as last time, so after changes, this only repairs.
+    template<typename PV>
+    bool findPath(PV& path, Position start, Position end, unsigned step, JPS_Flags flags = JPS_Flag_Default);
+
+    // incremental pathfinding, same semantics as in Searcher
+    JPS_Result findPathInit(Position start, Position end, JPS_Flags flags = JPS_Flag_Default);
+    // Can be called again after moveStart() or notifyCellChanged() to repair the path
+    JPS_Result findPathStep(int limit);
+    template<typename PV>
+    JPS_Result findPathFinish(PV& path, unsigned step) const;
+
+    // The start moved, e.g. one step along the path. Does not need another findPathStep() unless cells changed as well.
+    inline void moveStart(Position p) { _start = p; }
+
+    // Call after cell (x, y) of the grid was changed. Returns false if out of memory.
+    bool notifyCellChanged(PosType x, PosType y);
+
+    // Cost of the path from the start to the end after findPathStep() returned JPS_FOUND_PATH
+    inline ScoreType getPathCost() const { return _gAt(_start); }
+
+    // Number of nodes expanded since the last findPathInit(), moveStart() or notifyCellChanged()
+    inline SizeT getNodesExpanded() const { return _expanded; }
+
+    SizeT getTotalMemoryInUse() const
+    {
+        return storage._getMemSize() + nodemap._getMemSize() + open._getMemSize() + _rhs._getMemSize();
+    }
+
+private:
+
+    const GRID& grid;
+    Storage storage; // Node::g is g, Node::f is the key; the open flag means "in the open list"
+    NodeMap nodemap;
+    OpenList open;
+    PodVec<ScoreType> _rhs; // per node: cost to the end according to its neighbors' g
+    Position _start, _last, _end;
+    ScoreType _km; // accumulated estimate change from start moves, instead of re-keying the open list
+    SizeT _startIdx;
+    SizeT _expanded;
+
+    static inline ScoreType _inf() { return ScoreType(1 << 30); }
+    static inline Position _step(const Position& p, unsigned d) { return Pos(p.x + DirX[d], p.y + DirY[d]); }
+    static inline unsigned _numDirs() { return POLICY::diagonal == Diagonal_Never ? 4 : 8; } // straight directions come first
+
+    inline ScoreType _gAt(const Position& p) const
+    {
+        const Node *n = nodemap.find(p.x, p.y);
+        return n ? n->g : _inf();
+    }
+
+    // Cost of going one step from p into direction d
+    ScoreType _cost(const Position& p, unsigned d) const
+    {
+        return CanStep<POLICY>(grid, p.x, p.y, d) ? POLICY::Costs::Cost(p, _step(p, d)) : _inf();
+    }
+
+    inline ScoreType _key(const Node& n) const
+    {
+        return Min(n.g, _rhs[storage.getindex(&n)]) + POLICY::Costs::Estimate(_start, n.pos) + _km;
+    }
+
+    // Node for p, created with infinite costs if it didn't exist. Might realloc the storage.
+    Node *_getNode(const Position& p)
+    {
+        Node *n = nodemap(p.x, p.y);
+        if(n && storage.getindex(n) == _rhs.size())
+        {
+            n->g = _inf();
+            _rhs.push_back(_inf());
+            if(_rhs.size() != storage.size())
+                return 0;
         }
-        while (prev);
+        return n;
     }
-    else
+
+    // Best cost to the end via one of p's neighbors
+    ScoreType _lookahead(const Position& p) const
     {
-        do
+        ScoreType best = _inf();
+        for(unsigned d = 0; d < _numDirs(); ++d)
         {
-            JPS_ASSERT(next != &next->getParent());
-            path.push_back(next->pos);
-            ++added;
-            next = &next->getParent();
+            const ScoreType c = _cost(p, d);
+            if(c == _inf())
+                continue;
+            const ScoreType g = _gAt(_step(p, d));
+            if(g != _inf() && c + g < best)
+                best = c + g;
         }
-        while (next->hasParent());
+        return best;
     }
 
-    // JPS::PathVector silently discards push_back() when memory allocation fails;
-    // detect that case and roll back.
-    if(path.size() != offset + added)
+    // Put n into the open list if it is inconsistent. Consistent nodes are skipped when they come out of the open list.
+    void _updateNode(Node& n)
     {
-        path.resize(offset);
-        return JPS_OUT_OF_MEMORY;
+        if(n.g == _rhs[storage.getindex(&n)])
+            return;
+        n.f = _key(n);
+        if(n.isOpen())
+            open.fixNode(n);
+        else
+        {
+            n.setOpen();
+            open.pushNode(&n);
+        }
     }
 
-    // Nodes were traversed backwards, fix that
-    Reverse(path.begin() + offset, path.end());
-    return JPS_FOUND_PATH;
-}
+    bool _expand(SizeT idx);
+    void _catchUp();
 
-//-----------------------------------------
+    // forbid ops
+    ReplanSearcher& operator=(const ReplanSearcher&);
+    ReplanSearcher(const ReplanSearcher&);
+};
 
-template <typename GRID> inline Node *Searcher<GRID>::getNode(const Position& pos)
+template <typename GRID, typename POLICY> template<typename PV> bool ReplanSearcher<GRID, POLICY>::findPath(PV& path, Position start, Position end, unsigned step, JPS_Flags flags)
 {
-    JPS_ASSERT(grid(pos.x, pos.y));
-    return nodemap(pos.x, pos.y);
+    JPS_Result res;
+    if(end == _end && _startIdx != noidx)
+    {
+        moveStart(start);
+        res = findPathStep(0);
+    }
+    else
+        res = findPathInit(start, end, flags);
+    if(res == JPS_EMPTY_PATH)
+        return true;
+    while(res == JPS_NEED_MORE_STEPS)
+        res = findPathStep(0);
+    return res == JPS_FOUND_PATH && findPathFinish(path, step) == JPS_FOUND_PATH;
 }
 
-template <typename GRID> Position Searcher<GRID>::jumpP(const Position &p, const Position& src)
+template <typename GRID, typename POLICY> JPS_Result ReplanSearcher<GRID, POLICY>::findPathInit(Position start, Position end, JPS_Flags flags)
 {
-    JPS_ASSERT(grid(p.x, p.y));
+    storage.clear();
+    nodemap.clear();
+    open.clear();
+    _rhs.clear();
+    _start = _last = start;
+    _end = end;
+    _km = 0;
+    _startIdx = noidx;
+    _expanded = 0;
 
-    int dx = int(p.x - src.x);
-    int dy = int(p.y - src.y);
-    JPS_ASSERT(dx || dy);
+    if(start == end && !(flags & (JPS_Flag_NoStartCheck|JPS_Flag_NoEndCheck)))
+        return grid(end.x, end.y) ? JPS_EMPTY_PATH : JPS_NO_PATH;
 
-    if(dx && dy)
-        return jumpD(p, dx, dy);
-    else if(dx)
-        return jumpX(p, dx);
-    else if(dy)
-        return jumpY(p, dy);
+    if(!(flags & JPS_Flag_NoStartCheck))
+        if(!grid(start.x, start.y))
+            return JPS_NO_PATH;
 
-    // not reached
-    JPS_ASSERT(false);
-    return npos;
+    if(!(flags & JPS_Flag_NoEndCheck))
+        if(!grid(end.x, end.y))
+            return JPS_NO_PATH;
+
+    Node *n = _getNode(end);
+    if(!n)
+        return JPS_OUT_OF_MEMORY;
+    _rhs[storage.getindex(n)] = 0;
+    _updateNode(*n);
+    _startIdx = 0; // valid from now on; the actual index is looked up in findPathStep()
+    return JPS_NEED_MORE_STEPS;
 }
 
-template <typename GRID> Position Searcher<GRID>::jumpD(Position p, int dx, int dy)
+// Moving the start changes all estimates. Instead of updating every key in the open list,
+// the change is added to all keys computed from now on, as in D* Lite.
+template <typename GRID, typename POLICY> void ReplanSearcher<GRID, POLICY>::_catchUp()
 {
-    JPS_ASSERT(grid(p.x, p.y));
-    JPS_ASSERT(dx && dy);
-
-    const Position endpos = endPos;
-    unsigned steps = 0;
-
-    while(true)
+    if(_last != _start)
     {
-        if(p == endpos)
-            break;
-
-        ++steps;
-        const PosType x = p.x;
-        const PosType y = p.y;
-
-        if( (grid(x-dx, y+dy) && !grid(x-dx, y)) || (grid(x+dx, y-dy) && !grid(x, y-dy)) )
-            break;
+        _km += POLICY::Costs::Estimate(_last, _start);
+        _last = _start;
+        _expanded = 0;
+    }
+}
 
-        const bool gdx = !!grid(x+dx, y);
-        const bool gdy = !!grid(x, y+dy);
+template <typename GRID, typename POLICY> bool ReplanSearcher<GRID, POLICY>::notifyCellChanged(PosType x, PosType y)
+{
+    if(_startIdx == noidx)
+        return true; // nothing to repair
+    _catchUp();
+    _expanded = 0;
+    // All steps that may have changed start and end in the 3x3 block around the cell
+    for(int dy = -1; dy <= 1; ++dy)
+        for(int dx = -1; dx <= 1; ++dx)
+        {
+            const Position p = Pos(x + dx, y + dy);
+            if(p == _end)
+                continue;
+            const ScoreType rhs = _lookahead(p);
+            if(rhs == _inf() && !nodemap.find(p.x, p.y))
+                continue; // never reached and still unreachable
+            Node *n = _getNode(p);
+            if(!n)
+                return false;
+            _rhs[storage.getindex(n)] = rhs;
+            _updateNode(*n);
+        }
+    return true;
+}
 
-        if(gdx && jumpX(Pos(x+dx, y), dx).isValid())
-            break;
+// Expand the node at storage index idx. Returns false if out of memory.
+template <typename GRID, typename POLICY> bool ReplanSearcher<GRID, POLICY>::_expand(SizeT idx)
+{
+    const Position pos = storage[idx].pos;
 
-        if(gdy && jumpY(Pos(x, y+dy), dy).isValid())
-            break;
+    // Create all neighbors first; this may realloc the storage
+    SizeT nb[8];
+    ScoreType cost[8];
+    unsigned cnt = 0;
+    for(unsigned d = 0; d < _numDirs(); ++d)
+    {
+        const ScoreType c = _cost(pos, d);
+        if(c == _inf())
+            continue;
+        Node *s = _getNode(_step(pos, d));
+        if(!s)
+            return false;
+        nb[cnt] = storage.getindex(s);
+        cost[cnt++] = c;
+    }
 
-        if((gdx || gdy) && grid(x+dx, y+dy))
+    Node& u = storage[idx];
+    const ScoreType rhs = _rhs[idx];
+    if(u.g > rhs)
+    {
+        // Got cheaper: neighbors may get cheaper, too
+        u.g = rhs;
+        for(unsigned i = 0; i < cnt; ++i)
         {
-            p.x += dx;
-            p.y += dy;
+            Node& s = storage[nb[i]];
+            ScoreType& srhs = _rhs[nb[i]];
+            if(s.pos != _end && u.g + cost[i] < srhs)
+            {
+                srhs = u.g + cost[i];
+                _updateNode(s);
+            }
         }
-        else
+    }
+    else
+    {
+        // Got more expensive: neighbors that went through u need to look for something else, u as well
+        const ScoreType gOld = u.g;
+        u.g = _inf();
+        for(unsigned i = 0; i < cnt; ++i)
         {
-            p = npos;
-            break;
+            Node& s = storage[nb[i]];
+            ScoreType& srhs = _rhs[nb[i]];
+            if(s.pos != _end && srhs == gOld + cost[i])
+            {
+                srhs = _lookahead(s.pos);
+                _updateNode(s);
+            }
         }
+        if(u.pos != _end)
+            _rhs[idx] = _lookahead(u.pos);
+        _updateNode(u);
     }
-    stepsDone += steps;
-    stepsRemain -= steps;
-    return p;
+    ++_expanded;
+    return true;
 }
 
-template <typename GRID> inline Position Searcher<GRID>::jumpX(Position p, int dx)
+template <typename GRID, typename POLICY> JPS_Result ReplanSearcher<GRID, POLICY>::findPathStep(int limit)
 {
-    JPS_ASSERT(dx);
-    JPS_ASSERT(grid(p.x, p.y));
-
-    const PosType y = p.y;
-    const Position endpos = endPos;
-    unsigned steps = 0;
-
-    unsigned a = ~((!!grid(p.x, y+1)) | ((!!grid(p.x, y-1)) << 1));
+    JPS_ASSERT(_startIdx != noidx); // findPathInit() must have succeeded
+    _catchUp();
+    Node *sn = _getNode(_start); // this might realloc the storage
+    if(!sn)
+        return JPS_OUT_OF_MEMORY;
+    _startIdx = storage.getindex(sn);
 
-    while(true)
+    while(!open.empty())
     {
-        const unsigned xx = p.x + dx;
-        const unsigned b = (!!grid(xx, y+1)) | ((!!grid(xx, y-1)) << 1);
-
-        if((b & a) || p == endpos)
-            break;
-        if(!grid(xx, y))
+        Node& u = open.popNode();
+        u.clearOpen();
+        const SizeT idx = storage.getindex(&u);
+        if(u.g == _rhs[idx])
+            continue; // became consistent after it was put into the open list
+
+        // The open list only orders by the first part of the D* Lite key, so this keeps going
+        // while keys tie with the start's to make sure that the start's cost is final.
+        const Node& s = storage[_startIdx];
+        const ScoreType srhs = _rhs[_startIdx];
+        if(u.f > _key(s) && s.g == srhs)
         {
-            p = npos;
+            u.setOpen();
+            open.pushNode(&u);
             break;
         }
+        const ScoreType k = _key(u);
+        if(u.f < k) // estimate changed since it was put into the open list
+        {
+            u.f = k;
+            u.setOpen();
+            open.pushNode(&u);
+            continue;
+        }
+        if(!_expand(idx))
+            return JPS_OUT_OF_MEMORY;
+        if(limit && --limit <= 0)
+            return JPS_NEED_MORE_STEPS;
+    }
+    const Node& s = storage[_startIdx];
+    return s.g == _inf() ? JPS_NO_PATH : JPS_FOUND_PATH;
+}
 
-        p.x += dx;
-        a = ~b;
-        ++steps;
+// Follows the cheapest neighbors from the start to the end
+template <typename GRID, typename POLICY> template<typename PV> JPS_Result ReplanSearcher<GRID, POLICY>::findPathFinish(PV& path, unsigned step) const
+{
+    if(_start == _end)
+        return JPS_FOUND_PATH;
+    if(_gAt(_start) == _inf())
+        return JPS_NO_PATH;
+
+    const size_t offset = path.size();
+    SizeT added = 0, run = 0;
+    Position cur = _start;
+    unsigned lastDir = 8;
+    for(SizeT n = 0; cur != _end; ++n)
+    {
+        ScoreType best = _inf();
+        unsigned dir = 8;
+        for(unsigned d = 0; d < _numDirs(); ++d)
+        {
+            const ScoreType c = _cost(cur, d);
+            if(c == _inf())
+                continue;
+            const ScoreType g = _gAt(_step(cur, d));
+            if(g != _inf() && c + g < best)
+            {
+                best = c + g;
+                dir = d;
+            }
+        }
+        if(dir == 8 || n > storage.size())
+        {
+            path.resize(offset); // costs aren't up to date; findPathStep() wasn't called after a change
+            return JPS_NO_PATH;
+        }
+        // Same output as Searcher: every cell with step 1, otherwise turns and every step-th cell
+        if(lastDir != 8 && (dir != lastDir || (step && run >= step)))
+        {
+            path.push_back(cur);
+            ++added;
+            run = 0;
+        }
+        lastDir = dir;
+        cur = _step(cur, dir);
+        ++run;
     }
+    path.push_back(_end);
+    ++added;
 
-    stepsDone += steps;
-    stepsRemain -= steps;
-    return p;
+    // JPS::PathVector silently discards push_back() when memory allocation fails; roll back everything.
+    if(path.size() != offset + added)
+    {
+        path.resize(offset);
+        return JPS_OUT_OF_MEMORY;
+    }
+    return JPS_FOUND_PATH;
 }
 
-template <typename GRID> inline Position Searcher<GRID>::jumpY(Position p, int dy)
+// Caches the results of another searcher's findPath(), for many agents asking for the same paths.
+// Keyed by (start, end, step, flags). The grid is split into square regions with a version stamp each;
+// update(x, y) after changing a cell drops only the cached paths that cross the cell's region, or pass one of its
+// cells diagonally (whether that step is allowed depends on the two cells next to it; see DiagonalRule).
+// Paths elsewhere stay cached as they are, so they remain walkable but are not necessarily the shortest anymore
+// if the change opened a shortcut. Failed searches are cached too, until any cell changes.
+// Least recently used paths are dropped when the cache would exceed its memory cap.
+// SEARCHER can be anything with findPath(path, start, end, step, flags): Searcher, HierSearcher.
+template <typename SEARCHER>
+class PathCache
 {
-    JPS_ASSERT(dy);
-    JPS_ASSERT(grid(p.x, p.y));
+public:
+    PathCache(SEARCHER& search, void *user = 0)
+        : _search(search), _entries(user), _buckets(user), _regionStamp(user), _regions(user), _user(user)
+        , _head(noidx), _tail(noidx), _free(noidx), _count(0), _dataBytes(0), _cap(0)
+        , _rw(0), _rh(0), _regionSize(0), _stamp(0), _anyStamp(0), _hits(0), _misses(0)
+    {}
+    ~PathCache() { dealloc(); }
 
-    const PosType x = p.x;
-    const Position endpos = endPos;
-    unsigned steps = 0;
+    // Cells up to (w, h) are tracked; w, h should cover the grid.
+    // maxBytes caps the memory used for cached paths. Returns false if out of memory.
+    bool init(PosType w, PosType h, unsigned regionSize = 16, SizeT maxBytes = 1 << 20)
+    {
+        JPS_ASSERT(regionSize);
+        clear();
+        _regionSize = regionSize;
+        _rw = (w + regionSize - 1) / regionSize;
+        _rh = (h + regionSize - 1) / regionSize;
+        _cap = maxBytes;
+        _regionStamp.resize(_rw * _rh);
+        if(_regionStamp.size() != _rw * _rh)
+            return false;
+        _fill(_regionStamp, 0u);
+        return true;
+    }
 
-    unsigned a = ~((!!grid(x+1, p.y)) | ((!!grid(x-1, p.y)) << 1));
+    // Same as SEARCHER::findPath(), but answers from the cache if possible
+    template<typename PV>
+    bool findPath(PV& path, Position start, Position end, unsigned step = 0, JPS_Flags flags = JPS_Flag_Default);
 
-    while(true)
+    // Call after cell (x, y) was changed
+    void update(PosType x, PosType y)
     {
-        const unsigned yy = p.y + dy;
-        const unsigned b = (!!grid(x+1, yy)) | ((!!grid(x-1, yy)) << 1);
-
-        if((a & b) || p == endpos)
-            break;
-        if(!grid(x, yy))
+        if(!_regionSize)
+            return;
+        if(!++_stamp) // wrapped around; very unlikely, but stamps would be ambiguous
         {
-            p = npos;
-            break;
+            clear();
+            _fill(_regionStamp, 0u);
+            _stamp = 1;
         }
-
-        p.y += dy;
-        a = ~b;
-        ++steps;
+        _regionStamp[_regionOf(x, y)] = _stamp;
+        _anyStamp = _stamp;
     }
 
-    stepsDone += steps;
-    stepsRemain -= steps;
-    return p;
-}
+    // Drop all cached paths; keeps the statistics
+    void clear()
+    {
+        for(SizeT i = _head; i != noidx; i = _entries[i].next)
+            JPS_free(_entries[i].data, _entries[i].bytes, _user);
+        _entries.clear();
+        _fill(_buckets, noidx);
+        _head = _tail = _free = noidx;
+        _count = 0;
+        _dataBytes = 0;
+    }
 
-#define JPS_CHECKGRID(dx, dy) (grid(x+(dx), y+(dy)))
-#define JPS_ADDPOS(dx, dy)     do { *w++ = Pos(x+(dx), y+(dy)); } while(0)
-#define JPS_ADDPOS_CHECK(dx, dy) do { if(JPS_CHECKGRID(dx, dy)) JPS_ADDPOS(dx, dy); } while(0)
-#define JPS_ADDPOS_NO_TUNNEL(dx, dy) do { if(grid(x+(dx),y) || grid(x,y+(dy))) JPS_ADDPOS_CHECK(dx, dy); } while(0)
+    void dealloc()
+    {
+        clear();
+        _entries.dealloc();
+        _buckets.dealloc();
+        _regionStamp.dealloc();
+        _regions.dealloc();
+        _regionSize = 0;
+    }
 
-template <typename GRID> unsigned Searcher<GRID>::findNeighborsJPS(const Node& n, Position *wptr) const
-{
-    Position *w = wptr;
-    const unsigned x = n.pos.x;
-    const unsigned y = n.pos.y;
+    inline SizeT getHits() const { return _hits; }
+    inline SizeT getMisses() const { return _misses; }
+    inline void resetStats() { _hits = _misses = 0; }
+    inline SizeT getNumEntries() const { return _count; }
 
-    if(!n.hasParent())
+    SizeT getTotalMemoryInUse() const
     {
-        // straight moves
-        JPS_ADDPOS_CHECK(-1, 0);
-        JPS_ADDPOS_CHECK(0, -1);
-        JPS_ADDPOS_CHECK(0, 1);
-        JPS_ADDPOS_CHECK(1, 0);
+        return _dataBytes + _entries._getMemSize() + _buckets._getMemSize() + _regionStamp._getMemSize() + _regions._getMemSize();
+    }
 
-        // diagonal moves + prevent tunneling
-        JPS_ADDPOS_NO_TUNNEL(-1, -1);
-        JPS_ADDPOS_NO_TUNNEL(-1, 1);
-        JPS_ADDPOS_NO_TUNNEL(1, -1);
-        JPS_ADDPOS_NO_TUNNEL(1, 1);
+private:
 
-        return unsigned(w - wptr);
+    struct Entry
+    {
+        Position start, end;
+        unsigned step;
+        JPS_Flags flags;
+        unsigned stamp; // value of _stamp when stored
+        bool found;
+        SizeT npath, nregions; // data: npath positions, then nregions region indices
+        void *data;
+        SizeT bytes;
+        SizeT prev, next; // LRU list, most recently used first
+        SizeT chain; // next entry in the same bucket, or in the free list
+    };
+
+    SEARCHER& _search;
+    PodVec<Entry> _entries;
+    PodVec<SizeT> _buckets;
+    PodVec<unsigned> _regionStamp; // per region: value of _stamp when a cell in it last changed
+    PodVec<unsigned> _regions; // temporary
+    void * const _user;
+    SizeT _head, _tail, _free, _count;
+    SizeT _dataBytes, _cap;
+    PosType _rw, _rh;
+    unsigned _regionSize;
+    unsigned _stamp, _anyStamp;
+    SizeT _hits, _misses;
+
+    template<typename T>
+    static void _fill(PodVec<T>& v, T val)
+    {
+        for(SizeT i = 0; i < v.size(); ++i)
+            v[i] = val;
     }
-    const Node& p = n.getParent();
-    // jump directions (both -1, 0, or 1)
-    const int dx = Sgn<int>(x - p.pos.x);
-    const int dy = Sgn<int>(y - p.pos.y);
 
-    if(dx && dy)
+    inline unsigned _regionOf(PosType x, PosType y) const
     {
-        // diagonal
-        // natural neighbors
-        const bool walkX = !!grid(x+dx, y);
-        if(walkX)
-            *w++ = Pos(x+dx, y);
-        const bool walkY = !!grid(x, y+dy);
-        if(walkY)
-            *w++ = Pos(x, y+dy);
+        return Min<PosType>(y / _regionSize, _rh - 1) * _rw + Min<PosType>(x / _regionSize, _rw - 1);
+    }
 
-        if(walkX || walkY)
-            JPS_ADDPOS_CHECK(dx, dy);
+    static inline unsigned _hash(const Position& a, const Position& b, unsigned step, JPS_Flags flags)
+    {
+        unsigned h = a.x * 0x9E3779B1u;
+        h = (h ^ a.y) * 0x85EBCA77u;
+        h = (h ^ b.x) * 0xC2B2AE3Du;
+        h = (h ^ b.y) * 0x27D4EB2Fu;
+        h = (h ^ step ^ (flags << 8)) * 0x165667B1u;
+        return h ^ (h >> 15);
+    }
 
-        // forced neighbors
-        if(walkY && !JPS_CHECKGRID(-dx,0))
-            JPS_ADDPOS_CHECK(-dx, dy);
+    inline const Position *_pathOf(const Entry& e) const { return static_cast<const Position*>(e.data); }
+    inline const unsigned *_regionsOf(const Entry& e) const { return reinterpret_cast<const unsigned*>(_pathOf(e) + e.npath); }
 
-        if(walkX && !JPS_CHECKGRID(0,-dy))
-            JPS_ADDPOS_CHECK(dx, -dy);
+    bool _valid(const Entry& e) const
+    {
+        if(!e.found)
+            return _anyStamp <= e.stamp;
+        const unsigned *r = _regionsOf(e);
+        for(SizeT i = 0; i < e.nregions; ++i)
+            if(_regionStamp[r[i]] > e.stamp)
+                return false;
+        return true;
     }
-    else if(dx)
+
+    SizeT _find(const Position& a, const Position& b, unsigned step, JPS_Flags flags) const
     {
-        // along X axis
-        if(JPS_CHECKGRID(dx, 0))
+        if(_buckets.empty())
+            return noidx;
+        SizeT i = _buckets[_hash(a, b, step, flags) & (_buckets.size() - 1)];
+        for( ; i != noidx; i = _entries[i].chain)
         {
-            JPS_ADDPOS(dx, 0);
-
-             // Forced neighbors (+ prevent tunneling)
-            if(!JPS_CHECKGRID(0, 1))
-                JPS_ADDPOS_CHECK(dx, 1);
-            if(!JPS_CHECKGRID(0,-1))
-                JPS_ADDPOS_CHECK(dx,-1);
+            const Entry& e = _entries[i];
+            if(e.start == a && e.end == b && e.step == step && e.flags == flags)
+                break;
         }
+        return i;
     }
-    else if(dy)
+
+    void _unlink(SizeT i)
     {
-        // along Y axis
-        if(JPS_CHECKGRID(0, dy))
-        {
-            JPS_ADDPOS(0, dy);
+        Entry& e = _entries[i];
+        (e.prev != noidx ? _entries[e.prev].next : _head) = e.next;
+        (e.next != noidx ? _entries[e.next].prev : _tail) = e.prev;
+    }
 
-            // Forced neighbors (+ prevent tunneling)
-            if(!JPS_CHECKGRID(1, 0))
-                JPS_ADDPOS_CHECK(1, dy);
-            if(!JPS_CHECKGRID(-1, 0))
-                JPS_ADDPOS_CHECK(-1,dy);
-        }
+    void _linkFront(SizeT i)
+    {
+        Entry& e = _entries[i];
+        e.prev = noidx;
+        e.next = _head;
+        (_head != noidx ? _entries[_head].prev : _tail) = i;
+        _head = i;
     }
 
-    return unsigned(w - wptr);
-}
+    void _remove(SizeT i)
+    {
+        Entry& e = _entries[i];
+        SizeT *pi = &_buckets[_hash(e.start, e.end, e.step, e.flags) & (_buckets.size() - 1)];
+        while(*pi != i)
+            pi = &_entries[*pi].chain;
+        *pi = e.chain;
+        _unlink(i);
+        JPS_free(e.data, e.bytes, _user);
+        _dataBytes -= e.bytes;
+        e.data = 0;
+        e.chain = _free;
+        _free = i;
+        --_count;
+    }
 
-//-------------- Plain old A* search ----------------
-template <typename GRID> unsigned Searcher<GRID>::findNeighborsAStar(const Node& n, Position *wptr)
-{
-    Position *w = wptr;
-    const int x = n.pos.x;
-    const int y = n.pos.y;
-    const int d = 1;
-    JPS_ADDPOS_NO_TUNNEL(-d, -d);
-    JPS_ADDPOS_CHECK    ( 0, -d);
-    JPS_ADDPOS_NO_TUNNEL(+d, -d);
-    JPS_ADDPOS_CHECK    (-d,  0);
-    JPS_ADDPOS_CHECK    (+d,  0);
-    JPS_ADDPOS_NO_TUNNEL(-d, +d);
-    JPS_ADDPOS_CHECK    ( 0, +d);
-    JPS_ADDPOS_NO_TUNNEL(+d, +d);
-    stepsDone += 8;
-    return unsigned(w - wptr);
-}
+    // Double the bucket count when it gets crowded; failing to do so only makes lookups slower
+    void _rehash()
+    {
+        const SizeT n = _buckets.empty() ? 64 : _buckets.size() * 2;
+        PodVec<SizeT> b(_user);
+        b.resize(n);
+        if(b.size() != n)
+            return;
+        _fill(b, noidx);
+        for(SizeT i = _head; i != noidx; i = _entries[i].next)
+        {
+            Entry& e = _entries[i];
+            SizeT& head = b[_hash(e.start, e.end, e.step, e.flags) & (n - 1)];
+            e.chain = head;
+            head = i;
+        }
+        _buckets.swap(b);
+    }
 
-//-------------------------------------------------
-#undef JPS_ADDPOS
-#undef JPS_ADDPOS_CHECK
-#undef JPS_ADDPOS_NO_TUNNEL
-#undef JPS_CHECKGRID
+    template<typename IT>
+    void _store(const Position& a, const Position& b, unsigned step, JPS_Flags flags, bool found, IT it, SizeT npath);
 
+    // forbid ops
+    PathCache& operator=(const PathCache&);
+    PathCache(const PathCache&);
+};
 
-template <typename GRID> bool Searcher<GRID>::identifySuccessors(const Node& n_)
+template <typename SEARCHER> template<typename PV> bool PathCache<SEARCHER>::findPath(PV& path, Position start, Position end, unsigned step, JPS_Flags flags)
 {
-    const SizeT nidx = storage.getindex(&n_);
-    const Position np = n_.pos;
-    Position buf[8];
-
-    const int num = (flags & JPS_Flag_AStarOnly)
-        ? findNeighborsAStar(n_, &buf[0])
-        : findNeighborsJPS(n_, &buf[0]);
-
-    for(int i = num-1; i >= 0; --i)
+    SizeT i = _find(start, end, step, flags);
+    if(i != noidx && !_valid(_entries[i]))
     {
-        // Invariant: A node is only a valid neighbor if the corresponding grid position is walkable (asserted in jumpP)
-        Position jp;
-        if(flags & JPS_Flag_AStarOnly)
-            jp = buf[i];
-        else
+        _remove(i);
+        i = noidx;
+    }
+    if(i != noidx)
+    {
+        ++_hits;
+        _unlink(i);
+        _linkFront(i);
+        const Entry& e = _entries[i];
+        const size_t offset = path.size();
+        const Position *p = _pathOf(e);
+        for(SizeT k = 0; k < e.npath; ++k)
+            path.push_back(p[k]);
+        if(path.size() != offset + e.npath) // JPS::PathVector silently fails on OOM
         {
-            jp = jumpP(buf[i], np);
-            if(!jp.isValid())
-                continue;
+            path.resize(offset);
+            return false;
         }
-        // Now that the grid position is definitely a valid jump point, we have to create the actual node.
-        Node *jn = getNode(jp); // this might realloc the storage
-        if(!jn)
-            return false; // out of memory
-
-        Node& n = storage[nidx]; // get valid ref in case we realloc'd
-        JPS_ASSERT(jn != &n);
-        if(!jn->isClosed())
-            _expandNode(jp, *jn, n);
+        return e.found;
     }
-    return true;
+
+    ++_misses;
+    const size_t offset = path.size();
+    const bool found = _search.findPath(path, start, end, step, flags);
+    if(_regionSize)
+        _store(start, end, step, flags, found, path.begin() + offset, found ? SizeT(path.size() - offset) : 0);
+    return found;
 }
 
-template <typename GRID> template<typename PV> bool Searcher<GRID>::findPath(PV& path, Position start, Position end, unsigned step, JPS_Flags flags)
+// Caching is best-effort: if anything fails, the path is simply not cached.
+template <typename SEARCHER> template<typename IT> void PathCache<SEARCHER>::_store(const Position& a, const Position& b, unsigned step, JPS_Flags flags, bool found, IT it, SizeT npath)
 {
-    JPS_Result res = findPathInit(start, end, flags);
-
-    // If this is true, the resulting path is empty (findPathFinish() would fail, so this needs to be checked before)
-    if(res == JPS_EMPTY_PATH)
-        return true;
-
-    while(true)
+    // Walk the path cell by cell to find the regions it crosses; path segments are straight or diagonal.
+    // A diagonal step also depends on the two cells it passes, which may be in other regions.
+    _regions.clear();
+    if(found)
     {
-        switch(res)
+        Position cur = a;
+        _regions.push_back(_regionOf(cur.x, cur.y));
+        for(SizeT k = 0; k < npath; ++k)
         {
-            case JPS_NEED_MORE_STEPS:
-                res = findPathStep(0);
-                break; // the switch
-
-            case JPS_FOUND_PATH:
-                return findPathFinish(path, step) == JPS_FOUND_PATH;
+            const Position next = *(it + k);
+            while(cur != next)
+            {
+                const int dx = (cur.x < next.x) - (next.x < cur.x);
+                const int dy = (cur.y < next.y) - (next.y < cur.y);
+                unsigned r[3];
+                unsigned n = 0;
+                if(dx && dy)
+                {
+                    r[n++] = _regionOf(cur.x + dx, cur.y);
+                    r[n++] = _regionOf(cur.x, cur.y + dy);
+                }
+                cur.x += dx;
+                cur.y += dy;
+                r[n++] = _regionOf(cur.x, cur.y);
+                for(unsigned j = 0; j < n; ++j)
+                    if(r[j] != _regions.back())
+                        _regions.push_back(r[j]);
+            }
+        }
+    }
 
-            case JPS_EMPTY_PATH:
-                JPS_ASSERT(false); // can't happen
-                // fall through
-            case JPS_NO_PATH:
-            case JPS_OUT_OF_MEMORY:
-                return false;
+    const SizeT nregions = _regions.size();
+    const SizeT bytes = npath * sizeof(Position) + nregions * sizeof(unsigned);
+    if(bytes + sizeof(Entry) > _cap)
+        return;
+    while(_count && _dataBytes + (_count + 1) * sizeof(Entry) + bytes > _cap)
+        _remove(_tail);
+
+    void *data = bytes ? JPS_realloc(0, bytes, 0, _user) : 0;
+    if(bytes && !data)
+        return;
+    SizeT i = _free;
+    if(i != noidx)
+        _free = _entries[i].chain;
+    else
+    {
+        i = _entries.size();
+        if(!_entries.alloc())
+        {
+            JPS_free(data, bytes, _user);
+            return;
         }
     }
+    if(_count >= _buckets.size())
+        _rehash();
+    if(_buckets.empty())
+    {
+        _entries[i].chain = _free;
+        _free = i;
+        JPS_free(data, bytes, _user);
+        return;
+    }
+
+    Position *p = static_cast<Position*>(data);
+    for(SizeT k = 0; k < npath; ++k)
+        p[k] = *(it + k);
+    unsigned *r = reinterpret_cast<unsigned*>(p + npath);
+    for(SizeT k = 0; k < nregions; ++k)
+        r[k] = _regions[k];
+
+    Entry& e = _entries[i];
+    e.start = a;
+    e.end = b;
+    e.step = step;
+    e.flags = flags;
+    e.stamp = _stamp;
+    e.found = found;
+    e.npath = npath;
+    e.nregions = nregions;
+    e.data = data;
+    e.bytes = bytes;
+    SizeT& head = _buckets[_hash(a, b, step, flags) & (_buckets.size() - 1)];
+    e.chain = head;
+    head = i;
+    _linkFront(i);
+    _dataBytes += bytes;
+    ++_count;
 }
 
-template <typename GRID> JPS_Result Searcher<GRID>::findPathInit(Position start, Position end, JPS_Flags flags)
+// Flow field for many agents heading to the same goal: A single Dijkstra search backwards from the goal
+// stores the cost to the goal and the direction of the next step for each cell, so agents can just follow
+// the directions from wherever they are, without searching at all.
+// Works on the rectangle of w*h cells at (x0, y0); cells outside are treated as blocked.
+// The caller provides the arrays, w*h entries each, row by row: Cell (x, y) is at index (y - y0) * w + (x - x0).
+//   dist: cost to get to the goal, or noscore if the goal can't be reached from there.
+//   dir: direction of the next step (use getStep()), NoDir at the goal and where it can't be reached.
+// The rectangle is split into tiles. Each pass runs a Dijkstra search in every tile next to one that changed
+// in the last pass, starting from the costs along the tile border, until nothing changes anymore.
+// Multiple threads:
+//   Tiles are colored like a 2x2 checkerboard, so tiles of the same color never touch each other.
+//   After buildInit(), for color = 0..3: call buildPass(color, part) from each thread, with part = 0..parts-1,
+//   and wait for all of them. Then call buildSync() from one thread; repeat all this while it returns JPS_NEED_MORE_STEPS.
+//   build() does the same on one thread.
+template <typename GRID, typename POLICY = SearchPolicy<Heuristic::OctileCosts, Expand_AStar> >
+class FlowField
 {
-    // This just resets a few counters; container memory isn't touched
-    this->clear();
+public:
+    enum { NoDir = 8 };
 
-    this->flags = flags;
-    endPos = end;
+    FlowField(const GRID& g, void *user = 0)
+        : grid(g), _heap(user), _active(user), _changed(user)
+        , _dist(0), _dir(0), _x0(0), _y0(0), _w(0), _h(0), _tile(0), _tw(0), _th(0), _parts(0), _goalTile(0), _goalIdx(0), _passes(0)
+    {}
 
-    // FIXME: check this
-    if(start == end && !(flags & (JPS_Flag_NoStartCheck|JPS_Flag_NoEndCheck)))
+    // single-call. Returns JPS_FOUND_PATH when done.
+    JPS_Result build(Position goal, ScoreType *dist, unsigned char *dir, PosType x0, PosType y0, PosType w, PosType h);
+
+    // Returns JPS_NEED_MORE_STEPS if passes are needed, or JPS_NO_PATH if the goal is blocked or outside the rectangle.
+    // parts: max. number of threads that call buildPass() at the same time.
+    JPS_Result buildInit(Position goal, ScoreType *dist, unsigned char *dir, PosType x0, PosType y0, PosType w, PosType h,
+                         unsigned parts = 1, unsigned tileSize = 64);
+    // Processes every parts-th tile of the color, starting with the part-th one
+    void buildPass(unsigned color, unsigned part);
+    JPS_Result buildSync();
+
+    // The next cell when following the direction stored for cell p
+    static inline Position getStep(const Position& p, unsigned char dir)
     {
-        // There is only a path if this single position is walkable.
-        // But since the starting position is omitted in the output, there is nothing to do here.
-        return grid(end.x, end.y) ? JPS_EMPTY_PATH : JPS_NO_PATH;
+        JPS_ASSERT(dir < NoDir);
+        return Pos(p.x + DirX[dir], p.y + DirY[dir]);
     }
 
-    if(!(flags & JPS_Flag_NoStartCheck))
-        if(!grid(start.x, start.y))
-            return JPS_NO_PATH;
+    inline SizeT getPasses() const { return _passes; }
 
-    if(!(flags & JPS_Flag_NoEndCheck))
-        if(!grid(end.x, end.y))
-            return JPS_NO_PATH;
+    void freeMemory()
+    {
+        _heap.dealloc();
+        _active.dealloc();
+        _changed.dealloc();
+        _parts = 0;
+    }
 
-    Node *endNode = getNode(end); // this might realloc the internal storage...
-    if(!endNode)
-        return JPS_OUT_OF_MEMORY;
-    endNodeIdx = storage.getindex(endNode); // .. so we keep this for later
+    SizeT getTotalMemoryInUse() const
+    {
+        return _heap._getMemSize() + _active._getMemSize() + _changed._getMemSize();
+    }
 
-    Node *startNode = getNode(start); // this might also realloc
-    if(!startNode)
-        return JPS_OUT_OF_MEMORY;
-    endNode = &storage[endNodeIdx]; // startNode is valid, make sure that endNode is valid too in case we reallocated
+private:
 
-    if(!(flags & JPS_Flag_NoGreedy))
+    struct HeapItem
     {
-        // Try the quick way out first
-        if(findPathGreedy(startNode, endNode))
-            return JPS_FOUND_PATH;
+        ScoreType d;
+        SizeT idx;
+    };
+
+    const GRID& grid;
+    PodVec<HeapItem> _heap; // one fixed-size min-heap per part, so that passes never allocate
+    PodVec<unsigned char> _active; // per tile: process in this pass
+    PodVec<unsigned char> _changed; // per tile: a border cell changed in this pass. Separate, since other threads read _active.
+    ScoreType *_dist;
+    unsigned char *_dir;
+    PosType _x0, _y0, _w, _h;
+    unsigned _tile, _tw, _th, _parts;
+    unsigned _goalTile;
+    SizeT _goalIdx, _passes;
+
+    // Every cell is pushed once when seeded from the border and at most once per neighbor, and never popped again after that
+    inline SizeT _heapCap() const { return SizeT(_tile) * _tile * 9; }
+
+    static inline bool _better(ScoreType d, ScoreType old) { return old == noscore || d < old; }
+    static inline unsigned char _opposite(unsigned d) { return (unsigned char)(d < 4 ? d ^ 1 : 11 - d); } // see DirX, DirY
+
+    void _push(HeapItem *heap, SizeT& n, ScoreType d, SizeT idx)
+    {
+        JPS_ASSERT(n < _heapCap());
+        SizeT i = n++;
+        while(i)
+        {
+            const SizeT p = (i - 1) >> 1;
+            if(!(d < heap[p].d))
+                break;
+            heap[i] = heap[p];
+            i = p;
+        }
+        heap[i].d = d;
+        heap[i].idx = idx;
     }
 
-    open.pushNode(startNode);
+    HeapItem _pop(HeapItem *heap, SizeT& n)
+    {
+        const HeapItem top = heap[0];
+        const HeapItem last = heap[--n];
+        SizeT i = 0;
+        for(;;)
+        {
+            SizeT c = 2 * i + 1;
+            if(c >= n)
+                break;
+            if(c + 1 < n && heap[c + 1].d < heap[c].d)
+                ++c;
+            if(!(heap[c].d < last.d))
+                break;
+            heap[i] = heap[c];
+            i = c;
+        }
+        if(n)
+            heap[i] = last;
+        return top;
+    }
 
-    return JPS_NEED_MORE_STEPS;
+    void _processTile(unsigned t, HeapItem *heap);
+    void _seed(unsigned t, PosType x, PosType y, HeapItem *heap, SizeT& n);
+
+    // forbid ops
+    FlowField& operator=(const FlowField&);
+    FlowField(const FlowField&);
+};
+
+template <typename GRID, typename POLICY> JPS_Result FlowField<GRID, POLICY>::build(Position goal, ScoreType *dist, unsigned char *dir, PosType x0, PosType y0, PosType w, PosType h)
+{
+    JPS_Result res = buildInit(goal, dist, dir, x0, y0, w, h);
+    while(res == JPS_NEED_MORE_STEPS)
+    {
+        for(unsigned color = 0; color < 4; ++color)
+            buildPass(color, 0);
+        res = buildSync();
+    }
+    return res;
 }
 
-template <typename GRID> JPS_Result Searcher<GRID>::findPathStep(int limit)
+template <typename GRID, typename POLICY> JPS_Result FlowField<GRID, POLICY>::buildInit(Position goal, ScoreType *dist, unsigned char *dir, PosType x0, PosType y0, PosType w, PosType h, unsigned parts, unsigned tileSize)
 {
-    stepsRemain = limit;
-    do
+    JPS_ASSERT(parts && tileSize);
+    _dist = dist;
+    _dir = dir;
+    _x0 = x0;
+    _y0 = y0;
+    _w = w;
+    _h = h;
+    _passes = 0;
+    for(SizeT i = 0; i < SizeT(w) * h; ++i)
     {
-        if(open.empty())
-            return JPS_NO_PATH;
-        Node& n = open.popNode();
-        n.setClosed();
-        if(n.pos == endPos)
-            return JPS_FOUND_PATH;
-        if(!identifySuccessors(n))
-            return JPS_OUT_OF_MEMORY;
+        dist[i] = noscore;
+        dir[i] = NoDir;
     }
-    while(stepsRemain >= 0);
+    if(goal.x - x0 >= w || goal.y - y0 >= h || !grid(goal.x, goal.y))
+        return JPS_NO_PATH;
+
+    _tile = tileSize;
+    _tw = (w + tileSize - 1) / tileSize;
+    _th = (h + tileSize - 1) / tileSize;
+    _parts = parts;
+    _heap.resize(_heapCap() * parts);
+    _active.resize(_tw * _th);
+    _changed.resize(_tw * _th);
+    if(_heap.size() != _heapCap() * parts || _active.size() != _tw * _th || _changed.size() != _tw * _th)
+        return JPS_OUT_OF_MEMORY;
+    for(SizeT i = 0; i < _active.size(); ++i)
+        _active[i] = _changed[i] = 0;
+
+    const PosType gx = goal.x - x0, gy = goal.y - y0;
+    _goalIdx = gy * w + gx;
+    _goalTile = (gy / tileSize) * _tw + gx / tileSize;
+    dist[_goalIdx] = 0;
+    _active[_goalTile] = 1;
     return JPS_NEED_MORE_STEPS;
 }
 
-template<typename GRID> template<typename PV> JPS_Result Searcher<GRID>::findPathFinish(PV& path, unsigned step) const
+template <typename GRID, typename POLICY> void FlowField<GRID, POLICY>::buildPass(unsigned color, unsigned part)
 {
-    return this->generatePath(path, step);
+    JPS_ASSERT(color < 4 && part < _parts);
+    HeapItem * const heap = &_heap[_heapCap() * part];
+    unsigned k = 0;
+    for(unsigned ty = color >> 1; ty < _th; ty += 2)
+        for(unsigned tx = color & 1; tx < _tw; tx += 2)
+        {
+            const unsigned t = ty * _tw + tx;
+            if(_active[t] && k++ % _parts == part)
+                _processTile(t, heap);
+        }
 }
 
-template<typename GRID> bool Searcher<GRID>::findPathGreedy(Node *n, Node *endnode)
+template <typename GRID, typename POLICY> void FlowField<GRID, POLICY>::_processTile(unsigned t, HeapItem *heap)
 {
-    Position midpos = npos;
-    PosType x = n->pos.x;
-    PosType y = n->pos.y;
-    const Position endpos = endnode->pos;
-
-    JPS_ASSERT(x != endpos.x || y != endpos.y); // must not be called when start==end
-    JPS_ASSERT(n != endnode);
+    const PosType tx0 = (t % _tw) * _tile, ty0 = (t / _tw) * _tile;
+    const PosType tx1 = Min<PosType>(tx0 + _tile, _w), ty1 = Min<PosType>(ty0 + _tile, _h);
+    SizeT n = 0;
 
-    int dx = int(endpos.x - x);
-    int dy = int(endpos.y - y);
-    const int adx = Abs(dx);
-    const int ady = Abs(dy);
-    dx = Sgn(dx);
-    dy = Sgn(dy);
+    // Start from the border cells; neighbor tiles have a different color, so no other thread writes to them right now
+    for(PosType x = tx0; x < tx1; ++x)
+    {
+        _seed(t, x, ty0, heap, n);
+        if(ty1 - 1 > ty0)
+            _seed(t, x, ty1 - 1, heap, n);
+    }
+    for(PosType y = ty0 + 1; y + 1 < ty1; ++y)
+    {
+        _seed(t, tx0, y, heap, n);
+        if(tx1 - 1 > tx0)
+            _seed(t, tx1 - 1, y, heap, n);
+    }
+    if(!_passes && t == _goalTile)
+        _push(heap, n, 0, _goalIdx);
 
-    // go diagonally first
-    if(x != endpos.x && y != endpos.y)
+    while(n)
     {
-        JPS_ASSERT(dx && dy);
-        const int minlen = Min(adx, ady);
-        const PosType tx = x + dx * minlen;
-        while(x != tx)
+        const HeapItem top = _pop(heap, n);
+        if(top.d != _dist[top.idx])
+            continue; // improved after it was pushed
+        const PosType x = top.idx % _w, y = top.idx / _w;
+        for(unsigned d = 0; d < 8; ++d)
         {
-            if(grid(x, y) && (grid(x+dx, y) || grid(x, y+dy))) // prevent tunneling as well
+            const PosType nx = x + DirX[d], ny = y + DirY[d];
+            if(nx - tx0 >= tx1 - tx0 || ny - ty0 >= ty1 - ty0)
+                continue; // not in this tile
+            if(!CanStep<POLICY>(grid, x + _x0, y + _y0, d))
+                continue;
+            const SizeT ni = ny * _w + nx;
+            const ScoreType c = top.d + POLICY::Costs::Cost(Pos(x + _x0, y + _y0), Pos(nx + _x0, ny + _y0));
+            if(_better(c, _dist[ni]))
             {
-                x += dx;
-                y += dy;
+                _dist[ni] = c;
+                _dir[ni] = _opposite(d);
+                _push(heap, n, c, ni);
+                if(nx == tx0 || nx == tx1 - 1 || ny == ty0 || ny == ty1 - 1)
+                    _changed[t] = 1;
             }
-            else
-                return false;
         }
-
-        if(!grid(x, y))
-            return false;
-
-        midpos = Pos(x, y);
     }
+}
 
-    // at this point, we're aligned to at least one axis
-    JPS_ASSERT(x == endpos.x || y == endpos.y);
-
-    if(!(x == endpos.x && y == endpos.y))
+// Border cell (x, y) of tile t: Take the best way out of the tile, if that is better than what the cell has
+template <typename GRID, typename POLICY> void FlowField<GRID, POLICY>::_seed(unsigned t, PosType x, PosType y, HeapItem *heap, SizeT& n)
+{
+    const PosType tx0 = (t % _tw) * _tile, ty0 = (t / _tw) * _tile;
+    const SizeT i = y * _w + x;
+    unsigned best = NoDir;
+    ScoreType bd = _dist[i];
+    for(unsigned d = 0; d < 8; ++d)
     {
-        while(x != endpos.x)
-            if(!grid(x += dx, y))
-                return false;
-
-        while(y != endpos.y)
-            if(!grid(x, y += dy))
-                return false;
-
-        JPS_ASSERT(x == endpos.x && y == endpos.y);
+        const PosType nx = x + DirX[d], ny = y + DirY[d];
+        if(nx >= _w || ny >= _h || (nx - tx0 < _tile && ny - ty0 < _tile))
+            continue; // outside the rectangle, or inside the tile
+        const ScoreType nd = _dist[ny * _w + nx];
+        if(nd == noscore || !CanStep<POLICY>(grid, x + _x0, y + _y0, d))
+            continue;
+        const ScoreType c = nd + POLICY::Costs::Cost(Pos(x + _x0, y + _y0), Pos(nx + _x0, ny + _y0));
+        if(_better(c, bd))
+        {
+            bd = c;
+            best = d;
+        }
     }
-
-    if(midpos.isValid())
+    if(best != NoDir)
     {
-        const unsigned nidx = storage.getindex(n);
-        Node *mid = getNode(midpos); // this might invalidate n, endnode
-        if(!mid)
-            return false;
-        n = &storage[nidx]; // reload pointers
-        endnode = &storage[endNodeIdx];
-        JPS_ASSERT(mid && mid != n);
-        mid->setParent(*n);
-        if(mid != endnode)
-            endnode->setParent(*mid);
+        _dist[i] = bd;
+        _dir[i] = (unsigned char)best;
+        _push(heap, n, bd, i);
+        _changed[t] = 1;
     }
-    else
-        endnode->setParent(*n);
+}
 
-    return true;
+// Next pass: All tiles next to one whose border changed
+template <typename GRID, typename POLICY> JPS_Result FlowField<GRID, POLICY>::buildSync()
+{
+    ++_passes;
+    bool any = false;
+    for(unsigned ty = 0; ty < _th; ++ty)
+        for(unsigned tx = 0; tx < _tw; ++tx)
+        {
+            unsigned char act = 0;
+            for(int dy = -1; dy <= 1 && !act; ++dy)
+                for(int dx = -1; dx <= 1 && !act; ++dx)
+                {
+                    const unsigned nx = tx + dx, ny = ty + dy;
+                    act = (dx || dy) && nx < _tw && ny < _th && _changed[ny * _tw + nx];
+                }
+            _active[ty * _tw + tx] = act;
+            any = any || act;
+        }
+    for(SizeT i = 0; i < _changed.size(); ++i)
+        _changed[i] = 0;
+    return any ? JPS_NEED_MORE_STEPS : JPS_FOUND_PATH;
 }
 
 #undef JPS_ASSERT
@@ -1457,6 +5037,18 @@ template<typename GRID> bool Searcher<GRID>::findPathGreedy(Node *n, Node *endno
 } // end namespace Internal
 
 using Internal::Searcher;
+using Internal::HierSearcher;
+using Internal::ReplanSearcher;
+using Internal::PathCache;
+using Internal::FlowField;
+using Internal::BitGrid;
+using Internal::JumpTable;
+using Internal::GoalBounds;
+using Internal::ComponentMap;
+using Internal::NodeMap;
+using Internal::DenseNodeMap;
+using Internal::OpenList;
+using Internal::BucketOpenList;
 
 typedef Internal::PodVec<Position> PathVector;
 
@@ -1534,6 +5126,5 @@ Changes compared to the older JPS.h at https://github.com/fgenesis/jps:
 TODO:
 - make int -> DirType
 - make possible to call findPathStep()/findPathFinish() even when JPS_EMPTY_PATH was returned on init (simplifies switch-case)
-- make node know its heap index
 - optional diagonals (make runtime param)
 */
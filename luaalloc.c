@@ -17,8 +17,9 @@ Background:
   This allocator groups allocations of the same (small) size into blocks and passes through larger allocations.
   Small allocations have an overhead of 1 bit plus some bookkeeping information for each block.
   This allocator is also rather fast; in the typical case a block known to contain free slots is cached,
-  and inside of this block, finding a free slot is a tiny loop checking 32 slots at once,
-  followed by a CTZ (count trailing zeros) to locate the exact slot out of the 32.
+  and inside of this block, finding a free slot is two CTZ (count trailing zeros) operations:
+  The first one on a per-block summary word (1 bit per bitmap int that has any free slot) to find a bitmap int,
+  the second one to locate the exact slot out of the 32 in that bitmap int.
   Freeing is similar, first do a binary search to locate the block containing the pointer to be freed,
   then flip the bit for that slot to mark it as unused. (Bitmap position and bit index is computed from the address, no loop there.)
   Once a block for a given size bin is full, other blocks in this bin are filled. A new block is allocated from the system if there is no free block.
@@ -36,10 +37,14 @@ Inspired by:
 /* ---- Configuration begin ---- */
 
 /* Track allocation stats to get an overview of your memory usage. By default disabled in release mode. */
-#ifndef NDEBUG
+#if !defined(NDEBUG) && !defined(LA_TRACK_STATS)
 #  define LA_TRACK_STATS
 #endif
 
+/* Support mirroring per-bin counters into a caller-supplied memory area (e.g. shared memory), see luaalloc_setmetrics().
+   Costs one pointer check per update while no area is attached. Disabled by default; uncomment or define on the command line. */
+/*#define LA_ENABLE_METRICS*/
+
 /* Internal consistency checks. By default disabled in release mode. */
 #ifdef NDEBUG
 #  define LA_ASSERT(x)
@@ -70,9 +75,10 @@ Inspired by:
    Note that each element requires 1 bit in the bitmap, the number of elements is rounded up so that no bit is unused,
    and the bitmap array is sized accordingly. Best is to use powers of 2. */
 #define LA_ELEMS_MIN 64
-#define LA_ELEMS_MAX 2048 /* Stored in u16, don't go higher than 0x8000 */
+#define LA_ELEMS_MAX 2048 /* Stored in u16, don't go higher than 0x8000. Also limited to 64 bitmap ints per block (= 2048 for u32) */
 #define LA_GROW_BLOCK_SIZE(n) (n * 2)
 
+typedef unsigned long long u64;
 typedef unsigned int u32;
 typedef unsigned short u16;
 
@@ -112,6 +118,10 @@ typedef u32 ubitmap;
 # define HAS_BUILTIN_CTZ
 #endif
 
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+# define HAS_BITSCANFORWARD64
+#endif
+
 inline static unsigned ctz32(u32 x)
 {
 #if defined(HAS_BUILTIN_CTZ)
@@ -134,6 +144,34 @@ inline static unsigned ctz32(u32 x)
 #endif
 }
 
+inline static unsigned ctz64(u64 x)
+{
+#if defined(HAS_BUILTIN_CTZ)
+    return __builtin_ctzll(x);
+#elif defined(HAS_BITSCANFORWARD64)
+    unsigned long r = 0;
+    _BitScanForward64(&r, x);
+    return r;
+#else
+    const u32 lo = (u32)x;
+    return lo ? ctz32(lo) : 32 + ctz32((u32)(x >> 32));
+#endif
+}
+
+#ifdef LA_ENABLE_METRICS
+# if defined(__GNUC__) || defined(__clang__)
+#  define LA_FENCE_ACQUIRE() __atomic_thread_fence(__ATOMIC_ACQUIRE)
+#  define LA_FENCE_RELEASE() __atomic_thread_fence(__ATOMIC_RELEASE)
+# elif defined(_MSC_VER)
+#  include <intrin.h>
+#  define LA_FENCE_ACQUIRE() _ReadWriteBarrier() /* Enough on x86/x64, which don't reorder stores with stores or loads with loads */
+#  define LA_FENCE_RELEASE() _ReadWriteBarrier()
+# else
+#  define LA_FENCE_ACQUIRE() /* Hope for the best. volatile at least prevents compiler reordering */
+#  define LA_FENCE_RELEASE()
+# endif
+#endif
+
 /* ---- Structs for internal book-keeping ---- */
 
 #define BLOCK_ARRAY_SIZE  (LA_MAX_ALLOC / LA_ALLOC_STEP)
@@ -148,6 +186,7 @@ struct Block
     u16 bitmapInts;  /* const */
     Block *next;     /* dynamic */
     Block *prev;     /* dynamic */
+    u64 summary;     /* dynamic; bit i set if bitmap[i] has any free slot */
 
     ubitmap bitmap[1];
     /* bitmap area */
@@ -163,6 +202,9 @@ typedef struct LuaAlloc
     size_t allcap; /* capacity of array */
     LuaSysAlloc sysalloc;
     void *user;
+#ifdef LA_ENABLE_METRICS
+    volatile LuaAllocMetrics *metrics; /* Caller-supplied; NULL if not attached */
+#endif
 #ifdef LA_TRACK_STATS
     struct
     {
@@ -178,6 +220,9 @@ typedef struct LuaAlloc
 
 static const u16 BITMAP_ELEM_SIZE = sizeof(ubitmap) * CHAR_BIT;
 
+/* Block::summary has one bit per bitmap int */
+typedef char LA_ELEMS_MAX_too_large_for_summary[(LA_ELEMS_MAX <= 64 * sizeof(ubitmap) * CHAR_BIT) ? 1 : -1];
+
 inline static ubitmap *getbitmap(Block *b)
 {
     return &b->bitmap[0];
@@ -225,6 +270,8 @@ inline static void checkblock(Block *b)
     LA_ASSERT(b->elemsfree <= b->elemstotal);
     LA_ASSERT(b->elemstotal >= LA_ELEMS_MIN);
     LA_ASSERT(b->elemstotal <= LA_ELEMS_MAX);
+    LA_ASSERT(!b->elemsfree == !b->summary);
+    LA_ASSERT(b->bitmapInts == 64 || !(b->summary >> b->bitmapInts));
 }
 
 inline static size_t blocksize(Block *b)
@@ -240,6 +287,41 @@ inline static u16 nextblockelems(Block *b)
     return (u16)(n < LA_ELEMS_MAX ? n : LA_ELEMS_MAX);
 }
 
+/* ---- Metrics ---- */
+
+#define METRICS_LARGE_BIN    BLOCK_ARRAY_SIZE
+#define METRICS_INTERNAL_BIN (BLOCK_ARRAY_SIZE + 1)
+#define METRICS_READ_TRIES   (1u << 20) /* Updates take a few instructions; if seq stays odd longer, the writer is stuck or gone */
+
+#ifdef LA_ENABLE_METRICS
+/* Seqlock-style update; there is only ever one writer */
+static void _metricsupdate(volatile LuaAllocMetrics *M, unsigned bin, int dalive, unsigned dtotal, int dblocks, ptrdiff_t dbytes, unsigned dsys)
+{
+    M->seq++;
+    LA_FENCE_RELEASE();
+    if(bin == METRICS_INTERNAL_BIN)
+    {
+        M->internalbytes += dbytes;
+        M->internalsysallocs += dsys;
+    }
+    else
+    {
+        volatile LuaAllocBinMetrics *b = &M->bins[bin];
+        b->alive += dalive;
+        b->total += dtotal;
+        b->blocks += dblocks;
+        b->bytes += dbytes;
+        b->sysallocs += dsys;
+    }
+    LA_FENCE_RELEASE();
+    M->seq++;
+}
+#  define METRICS_UPDATE(LA, bin, dalive, dtotal, dblocks, dbytes, dsys) \
+    do { if((LA)->metrics) _metricsupdate((LA)->metrics, (bin), (dalive), (dtotal), (dblocks), (dbytes), (dsys)); } while(0)
+#else
+#  define METRICS_UPDATE(LA, bin, dalive, dtotal, dblocks, dbytes, dsys)
+#endif
+
 /* ---- System allocator interface ---- */
 
 typedef enum
@@ -291,6 +373,7 @@ static Block *_allocblock(LuaAlloc *LA, u16 nelems, u16 elemsz)
     b->bitmapInts = nbitmap;
     b->next = NULL;
     b->prev = NULL;
+    b->summary = nbitmap < 64 ? ((u64)1 << nbitmap) - 1 : ~(u64)0;
     LA_MEMSET(b->bitmap, -1, nbitmap * sizeof(ubitmap)); /* mark all as free */
 
     return b;
@@ -324,9 +407,10 @@ static size_t enlarge(LuaAlloc *LA)
 {
     const size_t incr = (LA->allcap / 2) + 16;
     const size_t newcap = LA->allcap + incr; /* Rough guess */
-    Block **newall = (Block**)sysrealloc(LA, LA->all, LA->all ? LA->allcap : LA_TYPE_INTERNAL, sizeof(Block*) * newcap);
+    Block **newall = (Block**)sysrealloc(LA, LA->all, LA->all ? LA->allcap * sizeof(Block*) : LA_TYPE_INTERNAL, sizeof(Block*) * newcap);
     if(newall)
     {
+        METRICS_UPDATE(LA, METRICS_INTERNAL_BIN, 0, 0, 0, (ptrdiff_t)(sizeof(Block*) * incr), 1);
         LA->all = newall;
         LA->allcap = newcap;
         return newcap;
@@ -372,6 +456,7 @@ static Block *insertblock(LuaAlloc * LA_RESTRICT LA, Block * LA_RESTRICT b)
 #ifdef LA_TRACK_STATS
     LA->stats.blocks_alive[si]++;
 #endif
+    METRICS_UPDATE(LA, si, 0, 0, 1, (ptrdiff_t)blocksize(b), 1);
 
     checkblock(b);
 
@@ -420,6 +505,7 @@ static void freeblock(LuaAlloc * LA_RESTRICT LA, Block ** LA_RESTRICT spot)
 #ifdef LA_TRACK_STATS
     LA->stats.blocks_alive[si]--;
 #endif
+    METRICS_UPDATE(LA, si, 0, 0, -1, -(ptrdiff_t)blocksize(b), 1);
 
     sysfree(LA, b, blocksize(b)); /* free it */
 }
@@ -433,14 +519,18 @@ static Block *newblock(LuaAlloc *LA, u16 nelems, u16 elemsz)
 static void *_Balloc(Block *b)
 {
     LA_ASSERT(b->elemsfree);
+    LA_ASSERT(b->summary); /* There must be a free slot because b->elemsfree != 0 */
     ubitmap *bitmap = b->bitmap;
-    unsigned i = 0, bm;
-    for( ; !(bm = bitmap[i]); ++i) {} /* as soon as one isn't all zero, there's a free slot */
-    LA_ASSERT(i < b->bitmapInts); /* And there must've been a free slot because b->elemsfree != 0 */
+    const unsigned i = ctz64(b->summary); /* First bitmap int that isn't all zero */
+    LA_ASSERT(i < b->bitmapInts);
+    ubitmap bm = bitmap[i];
+    LA_ASSERT(bm);
     ubitmap bitIdx = bitmap_CTZ(bm); /* Get exact location of free slot */
     LA_ASSERT(bm & ((ubitmap)1 << bitIdx)); /* make sure this is '1' (= free) */
     bm &= ~((ubitmap)1 << bitIdx); /* put '0' where '1' was (-> mark as non-free) */
     bitmap[i] = bm;
+    if(!bm)
+        b->summary &= ~((u64)1 << i); /* That was the last free slot in this bitmap int */
     --b->elemsfree;
     const size_t where = (i * (size_t)BITMAP_ELEM_SIZE) + bitIdx;
     void *ret = ((char*)getdata(b)) + (where * b->elemSize);
@@ -460,6 +550,7 @@ static void _Bfree(Block * LA_RESTRICT b, void * LA_RESTRICT p)
     LA_ASSERT(bitmapIdx < b->bitmapInts);
     LA_ASSERT(!(b->bitmap[bitmapIdx] & ((ubitmap)1 << bitIdx))); /* make sure this is '0' (= used) */
     b->bitmap[bitmapIdx] |= ((ubitmap)1 << bitIdx); /* put '1' where '0' was (-> mark as free) */
+    b->summary |= (u64)1 << bitmapIdx;
     ++b->elemsfree;
 }
 
@@ -499,11 +590,13 @@ static void *_Alloc(LuaAlloc *LA, size_t size)
             void *p = _Balloc(b);
             LA_ASSERT(p); /* Can't fail -- block was known to be free */
 
+            const unsigned si = bsizeindex(b);
 #ifdef LA_TRACK_STATS
-            unsigned si = bsizeindex(b);
             LA->stats.alive[si]++;
             LA->stats.total[si]++;
 #endif
+            METRICS_UPDATE(LA, si, 1, 1, 0, 0, 0);
+            (void)si;
             return p;
         }
         /* else try the alloc below */
@@ -518,16 +611,19 @@ static void *_Alloc(LuaAlloc *LA, size_t size)
         LA->stats.total[BLOCK_ARRAY_SIZE]++;
     }
 #endif
+    METRICS_UPDATE(LA, METRICS_LARGE_BIN, !!p, !!p, 0, p ? (ptrdiff_t)size : 0, 1);
     return p;
 }
 
 static void freefromspot(LuaAlloc * LA_RESTRICT LA, Block ** LA_RESTRICT spot, void *p)
 {
     Block *b = *spot;
+    const unsigned si = bsizeindex(b);
 #ifdef LA_TRACK_STATS
-    unsigned si = bsizeindex(b);
     LA->stats.alive[si]--;
 #endif
+    METRICS_UPDATE(LA, si, -1, 0, 0, 0, 0);
+    (void)si;
     if(b->elemsfree + 1 == b->elemstotal)
         freeblock(LA, spot); /* Freeing last element in the block -> just free the whole thing */
     else
@@ -563,6 +659,7 @@ static void _Free(LuaAlloc * LA_RESTRICT LA , void * LA_RESTRICT p, size_t oldsi
 #ifdef LA_TRACK_STATS
     LA->stats.alive[BLOCK_ARRAY_SIZE]--;
 #endif
+    METRICS_UPDATE(LA, METRICS_LARGE_BIN, -1, 0, 0, -(ptrdiff_t)oldsize, 1);
 
     sysfree(LA, p, oldsize); /* large Lua free */
 }
@@ -607,6 +704,17 @@ void *luaalloc(void * ud, void *ptr, size_t oldsize, size_t newsize)
     return NULL;
 }
 
+void *luaalloc_alloc(LuaAlloc *LA, size_t nsize)
+{
+    return _Alloc(LA, nsize);
+}
+
+void luaalloc_free(LuaAlloc *LA, void *p, size_t osize)
+{
+    if(p)
+        _Free(LA, p, osize);
+}
+
 #ifdef LA_ENABLE_DEFAULT_ALLOC
 void *defaultalloc(void *user, void *ptr, size_t osize, size_t nsize)
 {
@@ -649,6 +757,13 @@ void luaalloc_delete(LuaAlloc *LA)
     sysfree(LA, LA, sizeof(LuaAlloc)); /* free self */
 }
 
+void luaalloc_setsysalloc(LuaAlloc *LA, LuaSysAlloc sysalloc, void *user)
+{
+    LA_ASSERT(sysalloc);
+    LA->sysalloc = sysalloc;
+    LA->user = user;
+}
+
 /* ---- Optional stats tracking ---- */
 
 unsigned luaalloc_getstats(const LuaAlloc *LA, const size_t ** alive, const size_t ** total, const size_t ** blocks, unsigned *pbinstep)
@@ -675,6 +790,107 @@ unsigned luaalloc_getstats(const LuaAlloc *LA, const size_t ** alive, const size
 #endif
 }
 
+/* ---- Optional metrics export ---- */
+
+size_t luaalloc_metricssize(void)
+{
+    return offsetof(LuaAllocMetrics, bins) + (BLOCK_ARRAY_SIZE + 1) * sizeof(LuaAllocBinMetrics);
+}
+
+int luaalloc_setmetrics(LuaAlloc *LA, void *mem, size_t size)
+{
+#ifdef LA_ENABLE_METRICS
+    LA->metrics = NULL;
+    if(!mem)
+        return 1;
+    if(size < luaalloc_metricssize())
+        return 0;
+
+    LuaAllocMetrics *M = (LuaAllocMetrics*)mem;
+    LA_MEMSET(M, 0, luaalloc_metricssize());
+    M->nbins = BLOCK_ARRAY_SIZE + 1;
+    M->binstep = LA_ALLOC_STEP;
+    M->internalbytes = sizeof(LuaAlloc) + LA->allcap * sizeof(Block*);
+
+    for(size_t i = 0; i < LA->allnum; ++i)
+    {
+        Block *b = LA->all[i];
+        M->bins[bsizeindex(b)].bytes += blocksize(b);
+    }
+#ifdef LA_TRACK_STATS
+    for(unsigned i = 0; i < BLOCK_ARRAY_SIZE + 1; ++i)
+    {
+        M->bins[i].alive = LA->stats.alive[i];
+        M->bins[i].total = LA->stats.total[i];
+        M->bins[i].blocks = LA->stats.blocks_alive[i];
+    }
+#endif
+
+    LA_FENCE_RELEASE();
+    ((volatile LuaAllocMetrics*)M)->magic = LUAALLOC_METRICS_MAGIC; /* Set last; now readers may look at it */
+    LA->metrics = M;
+    return 1;
+#else
+    (void)LA;
+    (void)mem;
+    (void)size;
+    return 0;
+#endif
+}
+
+unsigned luaalloc_readmetrics(const void *mem, size_t memsize, LuaAllocMetrics *out, size_t outsize)
+{
+#ifdef LA_ENABLE_METRICS
+    const volatile LuaAllocMetrics *M = (const volatile LuaAllocMetrics*)mem;
+    if(memsize < offsetof(LuaAllocMetrics, bins) || M->magic != LUAALLOC_METRICS_MAGIC)
+        return 0;
+    LA_FENCE_ACQUIRE();
+    /* The area may come from another process; don't trust nbins to fit into it */
+    const unsigned nbins = M->nbins;
+    if(!nbins || nbins > (memsize - offsetof(LuaAllocMetrics, bins)) / sizeof(LuaAllocBinMetrics)
+        || outsize < offsetof(LuaAllocMetrics, bins) + nbins * sizeof(LuaAllocBinMetrics))
+        return 0;
+
+    unsigned seq, tries = METRICS_READ_TRIES;
+    for(;;)
+    {
+        if(!tries--)
+            return 0;
+        seq = M->seq;
+        if(seq & 1)
+            continue; /* Writer is busy, retry */
+        LA_FENCE_ACQUIRE();
+        out->internalbytes = M->internalbytes;
+        out->internalsysallocs = M->internalsysallocs;
+        for(unsigned i = 0; i < nbins; ++i)
+        {
+            const volatile LuaAllocBinMetrics *b = &M->bins[i];
+            LuaAllocBinMetrics *o = &out->bins[i];
+            o->alive = b->alive;
+            o->total = b->total;
+            o->blocks = b->blocks;
+            o->bytes = b->bytes;
+            o->sysallocs = b->sysallocs;
+        }
+        LA_FENCE_ACQUIRE();
+        if(M->seq == seq)
+            break;
+    }
+
+    out->magic = LUAALLOC_METRICS_MAGIC;
+    out->seq = seq;
+    out->nbins = nbins;
+    out->binstep = M->binstep;
+    return nbins;
+#else
+    (void)mem;
+    (void)memsize;
+    (void)out;
+    (void)outsize;
+    return 0;
+#endif
+}
+
 #ifdef __cplusplus
 }
 #endif
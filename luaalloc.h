@@ -12,6 +12,8 @@ Usage:
 
 #pragma once
 
+#include <stddef.h> /* for size_t */
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -35,6 +37,19 @@ LuaAlloc *luaalloc_create(LuaSysAlloc sysalloc, void *ud);
 /* Destroy allocator. Call after lua_close()ing each Lua state using the allocator. */
 void luaalloc_delete(LuaAlloc*);
 
+/* Replace the system allocator of an existing allocator context.
+   Only needed in special cases, e.g. after the memory of a LuaAlloc instance was restored
+   from a heap image (see luaalloc_arena.h), where the stored function pointer may be stale.
+   The new system allocator must be able to handle all memory handed out by the previous one. */
+void luaalloc_setsysalloc(LuaAlloc*, LuaSysAlloc sysalloc, void *ud);
+
+/* Sized allocation interface, for code that knows the size of its allocations (e.g. C++ containers, see luaalloc.hh).
+   Same pools as used for Lua, but skips the realloc-style dispatch of luaalloc().
+   luaalloc_alloc() returns NULL on failure. nsize must be > 0.
+   luaalloc_free() must be passed the same size that was used to allocate. p may be NULL. */
+void *luaalloc_alloc(LuaAlloc*, size_t nsize);
+void luaalloc_free(LuaAlloc*, void *p, size_t osize);
+
 /* Statistics tracking. Define LA_TRACK_STATS in luaalloc.c to use this. [Enabled by default in debug mode].
    Provides pointers to internal stats area. Each element corresponds to an internal allocation bin.
    - alive: How many allocations of a bin size are currently in use.
@@ -60,6 +75,48 @@ void luaalloc_delete(LuaAlloc*);
 */
 unsigned luaalloc_getstats(const LuaAlloc*, const size_t **alive, const size_t **total, const size_t **blocks, unsigned *pbinstep);
 
+/* Live metrics export. Define LA_ENABLE_METRICS in luaalloc.c to use this. [Disabled by default].
+   Mirrors per-bin counters into a memory area supplied by the caller, typically a shared memory page,
+   so that an external tool can sample the allocator of a running process without its cooperation.
+   The area is written by the thread using the LuaAlloc instance only, guarded by a sequence counter.
+   Readers must use luaalloc_readmetrics() (or do the same dance) to get a consistent snapshot.
+   - luaalloc_metricssize() returns the number of bytes required for the area.
+   - luaalloc_setmetrics() initializes the area and starts updating it.
+     Pass mem=NULL to stop. Returns 1 on success, 0 if the area is too small or metrics are disabled.
+     If LA_TRACK_STATS is enabled, alive/total/blocks start with the current values; otherwise at 0,
+     so ideally attach right after luaalloc_create().
+     The area must be suitably aligned for unsigned long long and stay valid until detached.
+   - luaalloc_readmetrics() copies a consistent snapshot of the area at 'mem', 'memsize' bytes large,
+     into 'out', which must have room for 'outsize' bytes.
+     Safe to call from any thread or process while the area is being updated.
+     Returns the number of bins, or 0 if 'mem' doesn't look like a metrics area, out is too small,
+     or the writer didn't finish an update in time (e.g. because it died or is stopped; try again later). */
+typedef struct LuaAllocBinMetrics
+{
+    unsigned long long alive;     /* Allocations currently in use */
+    unsigned long long total;     /* Allocations done in total */
+    unsigned long long blocks;    /* Blocks currently existing (always 0 for large allocations) */
+    unsigned long long bytes;     /* Bytes currently requested from the system allocator */
+    unsigned long long sysallocs; /* System allocator calls done in total */
+} LuaAllocBinMetrics;
+
+typedef struct LuaAllocMetrics
+{
+    unsigned magic;   /* LUAALLOC_METRICS_MAGIC */
+    unsigned seq;     /* Incremented before and after each update, so it is odd while an update is in progress */
+    unsigned nbins;   /* Number of entries in bins[]. Last one is for large allocations, like luaalloc_getstats() */
+    unsigned binstep; /* Bin size increment */
+    unsigned long long internalbytes; /* Allocator-internal memory */
+    unsigned long long internalsysallocs;
+    LuaAllocBinMetrics bins[1]; /* Actually nbins entries */
+} LuaAllocMetrics;
+
+#define LUAALLOC_METRICS_MAGIC 0x314d414cU /* "LAM1" */
+
+size_t luaalloc_metricssize(void);
+int luaalloc_setmetrics(LuaAlloc*, void *mem, size_t size);
+unsigned luaalloc_readmetrics(const void *mem, size_t memsize, LuaAllocMetrics *out, size_t outsize);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,132 @@
+#pragma once
+
+/*
+C++ interface for LuaAlloc. Lets host code share LuaAlloc's size-binned pools with Lua.
+Requires luaalloc.c + luaalloc.h. Compiles as C++98, does not require the STL.
+
+Usage:
+    LuaAlloc *LA = luaalloc_create(NULL, NULL);
+
+    // Single objects. The size is known at compile time, so this skips the luaalloc() dispatch.
+    Foo *foo = LuaAllocCpp::alloc<Foo>(LA);    // Constructs via Foo(); NULL if out of memory
+    LuaAllocCpp::free(LA, foo);                // Calls ~Foo() and frees; NULL is fine
+
+    // Containers, via a std::allocator-compatible template:
+    typedef LuaAllocCpp::Allocator<int> IntAlloc;
+    std::vector<int, IntAlloc> v(IntAlloc(LA));
+
+    ... use LA for Lua states as usual ...
+    luaalloc_delete(LA); // After everything was freed
+
+Notes:
+  - Same thread safety rules as for LuaAlloc: All users of a LuaAlloc instance must be on the same thread.
+  - Elements in a block are placed at multiples of their size (rounded up to LA_ALLOC_STEP),
+    so anything up to pointer alignment is fine. Over-aligned types are not supported.
+  - Allocator<T>::allocate() throws std::bad_alloc when out of memory if exceptions are enabled,
+    otherwise it returns NULL. Define LUAALLOC_CPP_NO_EXCEPTIONS to always return NULL.
+*/
+
+#include "luaalloc.h"
+
+#if !defined(LUAALLOC_CPP_NO_EXCEPTIONS) && !defined(__cpp_exceptions) && !defined(__EXCEPTIONS) && !defined(_CPPUNWIND)
+#  define LUAALLOC_CPP_NO_EXCEPTIONS
+#endif
+
+#ifndef LUAALLOC_CPP_NO_EXCEPTIONS
+#  include <new> // for std::bad_alloc
+#endif
+
+// operator new() without #include <new>, same trick as in jps.hh
+struct LuaAllocCpp__NewDummy {};
+inline void* operator new(size_t, LuaAllocCpp__NewDummy, void* ptr) { return ptr; }
+inline void  operator delete(void*, LuaAllocCpp__NewDummy, void*)       {}
+
+namespace LuaAllocCpp {
+
+// Allocate and default-construct a single T. Returns NULL if out of memory.
+template<typename T> inline T *alloc(LuaAlloc *LA)
+{
+    void *p = luaalloc_alloc(LA, sizeof(T));
+    return p ? new(LuaAllocCpp__NewDummy(), p) T() : (T*)0;
+}
+
+// Same, but copy-construct from an existing object.
+template<typename T> inline T *alloc(LuaAlloc *LA, const T& val)
+{
+    void *p = luaalloc_alloc(LA, sizeof(T));
+    return p ? new(LuaAllocCpp__NewDummy(), p) T(val) : (T*)0;
+}
+
+// Destroy and free a single T that was allocated via alloc<T>(). p may be NULL.
+template<typename T> inline void free(LuaAlloc *LA, T *p)
+{
+    if(p)
+    {
+        p->~T();
+        luaalloc_free(LA, p, sizeof(T));
+    }
+}
+
+template<typename T> class Allocator;
+
+template<> class Allocator<void>
+{
+public:
+    typedef void value_type;
+    typedef void* pointer;
+    typedef const void* const_pointer;
+    template<typename U> struct rebind { typedef Allocator<U> other; };
+};
+
+// std::allocator-compatible (C++98 and later), stateful allocator.
+// Not default-constructible: Always pass the LuaAlloc instance to use.
+template<typename T> class Allocator
+{
+public:
+    typedef T value_type;
+    typedef T* pointer;
+    typedef const T* const_pointer;
+    typedef T& reference;
+    typedef const T& const_reference;
+    typedef size_t size_type;
+    typedef ptrdiff_t difference_type;
+    template<typename U> struct rebind { typedef Allocator<U> other; };
+
+    Allocator(LuaAlloc *LA) : _LA(LA) {}
+    template<typename U> Allocator(const Allocator<U>& o) : _LA(o._getLA()) {}
+
+    inline pointer address(reference x) const { return &x; }
+    inline const_pointer address(const_reference x) const { return &x; }
+    inline size_type max_size() const { return size_type(-1) / sizeof(T); }
+
+    pointer allocate(size_type n, const void * = 0)
+    {
+        void *p = n ? luaalloc_alloc(_LA, n * sizeof(T)) : 0;
+#ifndef LUAALLOC_CPP_NO_EXCEPTIONS
+        if(n && !p)
+            throw std::bad_alloc();
+#endif
+        return static_cast<pointer>(p);
+    }
+
+    inline void deallocate(pointer p, size_type n)
+    {
+        luaalloc_free(_LA, p, n * sizeof(T));
+    }
+
+    inline void construct(pointer p, const T& val) { new(LuaAllocCpp__NewDummy(), p) T(val); }
+    inline void destroy(pointer p) { p->~T(); (void)p; }
+
+    inline LuaAlloc *_getLA() const { return _LA; }
+
+private:
+    LuaAlloc *_LA;
+};
+
+template<typename T, typename U>
+inline bool operator==(const Allocator<T>& a, const Allocator<U>& b) { return a._getLA() == b._getLA(); }
+
+template<typename T, typename U>
+inline bool operator!=(const Allocator<T>& a, const Allocator<U>& b) { return a._getLA() != b._getLA(); }
+
+} // end namespace LuaAllocCpp
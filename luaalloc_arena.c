@@ -0,0 +1,300 @@
+/* Arena mode for LuaAlloc: Persistent Lua heap images. See luaalloc_arena.h for usage.
+
+License:
+  Public domain, WTFPL, CC0 or your favorite permissive license; whatever is available in your country.
+
+Dependencies:
+  luaalloc.c, libc and a few POSIX/Linux calls (mmap, madvise, open, read, write).
+  Compiles as C99 or C++ code.
+
+Thread safety:
+  Same as LuaAlloc. An arena is not thread-safe.
+
+Background:
+  The arena is used as system allocator of a LuaAlloc instance, so everything LuaAlloc gets from the system
+  comes from one contiguous range of address space. The arena's own bookkeeping is stored at the start of that range.
+  Chunks are power-of-2 sized and recycled via one free list per size, which needs no per-chunk headers
+  since the system allocator interface always passes the size of a chunk.
+  Fresh chunks are carved off the end of the used area; the used area is never shrunk.
+  Saving dumps the used area. Loading maps the file copy-on-write at the original address,
+  plus anonymous memory for the rest of the reserved range.
+*/
+
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#  define _GNU_SOURCE /* for MAP_ANONYMOUS, MAP_NORESERVE, madvise(). Must come before any system header */
+#endif
+
+/* ---- Configuration begin ---- */
+
+/* Internal consistency checks. By default disabled in release mode. */
+#ifdef NDEBUG
+#  define LAA_ASSERT(x)
+#else
+#  include <assert.h>
+#  define LAA_ASSERT(x) assert(x)
+#endif
+
+/* Smallest chunk size, as power of 2. Also the chunk alignment. Must be at least sizeof(void*). */
+#define LAA_MIN_CHUNK_SHIFT 4
+
+/* Freed chunks of at least this size give their pages back to the OS. */
+#define LAA_RELEASE_SIZE (64 * 1024)
+
+/* ---- Configuration end ---- */
+
+#include "luaalloc_arena.h"
+
+#include <stddef.h> /* for size_t */
+#include <string.h> /* for memcpy, memset */
+
+#define LAA_MAGIC 0x4c41412aU /* "LAA*" */
+#define LAA_VERSION 1U
+#define LAA_NUM_CLASSES (sizeof(size_t) * 8)
+
+struct LuaAllocArena
+{
+    unsigned magic;
+    unsigned version;
+    unsigned ptrsize; /* Images are not portable between 32 and 64 bit */
+    unsigned pad_;
+    char *base; /* == this */
+    size_t reserved; /* size of the whole address range */
+    size_t used; /* bytes in use, starting at base. Fresh chunks come from here */
+    void *freelist[LAA_NUM_CLASSES]; /* one list of free chunks per power of 2 */
+    LuaAlloc *LA;
+    void *root;
+};
+
+#ifdef __linux__
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#ifndef MAP_FIXED_NOREPLACE
+#  define MAP_FIXED_NOREPLACE 0x100000
+#endif
+
+/* ---- Chunk management ---- */
+
+static unsigned sizeclass(size_t n)
+{
+    unsigned c = LAA_MIN_CHUNK_SHIFT;
+    while(((size_t)1 << c) < n)
+        ++c;
+    return c;
+}
+
+static void *_chunkalloc(LuaAllocArena *A, size_t nsize)
+{
+    const unsigned c = sizeclass(nsize);
+    if(c >= LAA_NUM_CLASSES)
+        return NULL;
+
+    void *p = A->freelist[c];
+    if(p)
+    {
+        A->freelist[c] = *(void**)p;
+        return p;
+    }
+
+    const size_t csize = (size_t)1 << c;
+    if(csize > A->reserved - A->used)
+        return NULL;
+    p = A->base + A->used;
+    A->used += csize;
+    return p;
+}
+
+static void _chunkfree(LuaAllocArena *A, void *p, size_t osize)
+{
+    LAA_ASSERT((char*)p >= A->base && (char*)p < A->base + A->used);
+    const unsigned c = sizeclass(osize);
+    const size_t csize = (size_t)1 << c;
+    if(csize >= LAA_RELEASE_SIZE)
+    {
+        /* Keep the first page for the free list link, drop the rest */
+        const size_t pagesize = (size_t)sysconf(_SC_PAGESIZE);
+        char *beg = (char*)((((size_t)p + sizeof(void*)) + (pagesize - 1)) & ~(pagesize - 1));
+        char *end = (char*)(((size_t)p + csize) & ~(pagesize - 1));
+        if(beg < end)
+            madvise(beg, end - beg, MADV_DONTNEED);
+    }
+    *(void**)p = A->freelist[c];
+    A->freelist[c] = p;
+}
+
+/* The system allocator for LuaAlloc. See luaalloc.h for the semantics. */
+static void *arenaalloc(void *ud, void *ptr, size_t osize, size_t nsize)
+{
+    LuaAllocArena *A = (LuaAllocArena*)ud;
+    if(!ptr)
+        return nsize ? _chunkalloc(A, nsize) : NULL; /* osize is the allocation type here; don't care */
+
+    if(!nsize)
+    {
+        _chunkfree(A, ptr, osize);
+        return NULL;
+    }
+
+    if(sizeclass(osize) == sizeclass(nsize))
+        return ptr; /* Still fits */
+
+    void *np = _chunkalloc(A, nsize);
+    if(!np)
+        return nsize < osize ? ptr : NULL; /* Shrink requests must not fail. Freeing a larger chunk under a smaller size is fine. */
+    memcpy(np, ptr, osize < nsize ? osize : nsize);
+    _chunkfree(A, ptr, osize);
+    return np;
+}
+
+/* ---- Public API ---- */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+LuaAllocArena *luaalloc_arena_create(void *addr, size_t size)
+{
+    const size_t hdr = (size_t)1 << sizeclass(sizeof(LuaAllocArena));
+    if(size <= hdr)
+        return NULL;
+
+    void *mem = mmap(addr, size, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | (addr ? MAP_FIXED_NOREPLACE : 0), -1, 0);
+    if(mem == MAP_FAILED)
+        return NULL;
+    if(addr && mem != addr) /* Old kernels don't know MAP_FIXED_NOREPLACE and treat addr as a hint */
+    {
+        munmap(mem, size);
+        return NULL;
+    }
+
+    LuaAllocArena *A = (LuaAllocArena*)mem;
+    memset(A, 0, sizeof(*A));
+    A->magic = LAA_MAGIC;
+    A->version = LAA_VERSION;
+    A->ptrsize = sizeof(void*);
+    A->base = (char*)mem;
+    A->reserved = size;
+    A->used = hdr;
+
+    A->LA = luaalloc_create(arenaalloc, A);
+    if(!A->LA)
+    {
+        munmap(mem, size);
+        return NULL;
+    }
+    return A;
+}
+
+void luaalloc_arena_delete(LuaAllocArena *A)
+{
+    if(A)
+        munmap(A->base, A->reserved);
+}
+
+int luaalloc_arena_save(const LuaAllocArena *A, const char *fn)
+{
+    int fd = open(fn, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0)
+        return 0;
+
+    const char *p = A->base;
+    size_t remain = A->used;
+    while(remain)
+    {
+        ssize_t w = write(fd, p, remain);
+        if(w <= 0)
+            break;
+        p += w;
+        remain -= (size_t)w;
+    }
+    return !close(fd) && !remain;
+}
+
+LuaAllocArena *luaalloc_arena_load(const char *fn)
+{
+    int fd = open(fn, O_RDONLY);
+    if(fd < 0)
+        return NULL;
+
+    LuaAllocArena hdr;
+    struct stat st;
+    if(pread(fd, &hdr, sizeof(hdr), 0) != (ssize_t)sizeof(hdr)
+        || fstat(fd, &st)
+        || hdr.magic != LAA_MAGIC || hdr.version != LAA_VERSION || hdr.ptrsize != sizeof(void*)
+        || hdr.used != (size_t)st.st_size || hdr.used > hdr.reserved)
+    {
+        close(fd);
+        return NULL;
+    }
+
+    /* Reserve the whole range first. This fails if anything else lives there already. */
+    void *mem = mmap(hdr.base, hdr.reserved, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED_NOREPLACE, -1, 0);
+    if(mem != hdr.base)
+    {
+        if(mem != MAP_FAILED)
+            munmap(mem, hdr.reserved);
+        close(fd);
+        return NULL;
+    }
+
+    /* Then put the image over the start of it. MAP_FIXED is fine here since we own the range. */
+    if(mmap(hdr.base, hdr.used, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0) != hdr.base)
+    {
+        munmap(mem, hdr.reserved);
+        close(fd);
+        return NULL;
+    }
+    close(fd); /* The mapping keeps the file referenced */
+
+    LuaAllocArena *A = (LuaAllocArena*)mem;
+    luaalloc_setsysalloc(A->LA, arenaalloc, A); /* In case this executable was loaded elsewhere */
+    luaalloc_setmetrics(A->LA, NULL, 0); /* Whatever was attached when saving is gone */
+    return A;
+}
+
+#else /* !__linux__ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+LuaAllocArena *luaalloc_arena_create(void *addr, size_t size) { (void)addr; (void)size; return NULL; }
+void luaalloc_arena_delete(LuaAllocArena *A) { LAA_ASSERT(!A); (void)A; }
+int luaalloc_arena_save(const LuaAllocArena *A, const char *fn) { (void)A; (void)fn; return 0; }
+LuaAllocArena *luaalloc_arena_load(const char *fn) { (void)fn; return NULL; }
+
+#endif
+
+LuaAlloc *luaalloc_arena_getalloc(const LuaAllocArena *A)
+{
+    return A->LA;
+}
+
+void luaalloc_arena_setroot(LuaAllocArena *A, void *root)
+{
+    A->root = root;
+}
+
+void *luaalloc_arena_getroot(const LuaAllocArena *A)
+{
+    return A->root;
+}
+
+size_t luaalloc_arena_used(const LuaAllocArena *A)
+{
+    return A->used;
+}
+
+size_t luaalloc_arena_reserved(const LuaAllocArena *A)
+{
+    return A->reserved;
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,78 @@
+/*
+Arena mode for LuaAlloc: Persistent Lua heap images.
+Requires luaalloc.c + luaalloc.h. For more info and compile-time config, see luaalloc_arena.c
+
+All memory of a LuaAlloc instance -- the instance itself, its blocks, and large Lua allocations --
+is placed in one reserved range of virtual address space.
+The whole heap can be saved to a file and later mapped back at the same address,
+so that a fully initialized Lua state is available without running any init code.
+Currently only supported on Linux. On other platforms the functions below fail gracefully.
+
+Usage:
+    LuaAllocArena *A = luaalloc_arena_create(NULL, (size_t)1 << 30); // reserve 1 GB of address space
+    LuaAlloc *LA = luaalloc_arena_getalloc(A);
+    lua_State *L = lua_newstate(luaalloc, LA);
+    ... load and initialize scripts ...
+    luaalloc_arena_setroot(A, L);
+    luaalloc_arena_save(A, "heap.img");
+
+    // Later, possibly in another process:
+    LuaAllocArena *A = luaalloc_arena_load("heap.img");
+    lua_State *L = (lua_State*)luaalloc_arena_getroot(A);
+    lua_setallocf(L, luaalloc, luaalloc_arena_getalloc(A)); // in case function pointers moved
+    ... use L ...
+    lua_close(L);
+    luaalloc_arena_delete(A);
+
+Caveats:
+  - A heap image is a raw memory dump. Any pointer that leads outside of the arena must still be valid
+    when the image is loaded. For Lua this means C functions and the panic function,
+    so the loading process must be the same executable (and shared libs) mapped at the same addresses,
+    e.g. built with -no-pie or run with ASLR disabled.
+  - Only save when no Lua code is running. Open files, userdata referencing external resources etc.
+    are not magically restored.
+  - Images are only compatible with the exact same build of LuaAlloc and Lua.
+*/
+
+#pragma once
+
+#include "luaalloc.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Opaque arena type */
+typedef struct LuaAllocArena LuaAllocArena;
+
+/* Reserve 'size' bytes of address space, preferably at 'addr' (pass NULL to let the OS decide),
+   and create a LuaAlloc instance that lives entirely in it. Pages are only committed when used.
+   Returns NULL on failure. */
+LuaAllocArena *luaalloc_arena_create(void *addr, size_t size);
+
+/* Release the whole arena, including the LuaAlloc instance and everything that was allocated from it.
+   Do not call luaalloc_delete() on the instance; lua_close() is optional. */
+void luaalloc_arena_delete(LuaAllocArena*);
+
+/* The LuaAlloc instance that lives in the arena. Pass this as 'ud' to lua_newstate(). */
+LuaAlloc *luaalloc_arena_getalloc(const LuaAllocArena*);
+
+/* One user pointer that is saved with the image, typically the lua_State*. Initially NULL. */
+void luaalloc_arena_setroot(LuaAllocArena*, void *root);
+void *luaalloc_arena_getroot(const LuaAllocArena*);
+
+/* Write the used part of the arena to a file. Returns 1 on success, 0 on failure. */
+int luaalloc_arena_save(const LuaAllocArena*, const char *fn);
+
+/* Map an image written by luaalloc_arena_save() back at its original address.
+   Pages are loaded lazily and copy-on-write, so this is fast even for large images.
+   Returns NULL if the file is invalid or the address range is not available in this process. */
+LuaAllocArena *luaalloc_arena_load(const char *fn);
+
+/* Bytes of the arena currently in use (= size of an image), and the reserved size. */
+size_t luaalloc_arena_used(const LuaAllocArena*);
+size_t luaalloc_arena_reserved(const LuaAllocArena*);
+
+#ifdef __cplusplus
+}
+#endif
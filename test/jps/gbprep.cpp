@@ -0,0 +1,112 @@
+// Goal bounding preprocessing tool.
+// How to use:
+// Set working directory to test/jps (= where this file resides), then run:
+//  ./gbprep maps/dao/den011d.map den011d.gb
+// to compute the goal bounds for a map and save them in serialized form.
+// Optionally pass a scenario file for that map to compare searches with and without goal bounding:
+//  ./gbprep maps/dao/den011d.map den011d.gb maps/den011d.map.scen
+// Preprocessing runs one Dijkstra search per walkable cell, so large maps take a long time.
+
+#include "jps.hh"
+
+#include <iostream>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include <math.h>
+#include <time.h>
+#include "ScenarioLoader.h"
+
+static double pathcost(JPS::Position last, const JPS::PathVector& path)
+{
+	double accu = 0;
+	for(size_t i = 0; i < path.size(); ++i)
+	{
+		const int dx = int(path[i].x - last.x);
+		const int dy = int(path[i].y - last.y);
+		accu += sqrt(double(dx*dx + dy*dy));
+		last = path[i];
+	}
+	return accu;
+}
+
+static int compare(const JPS::BitGrid& grid, const JPS::GoalBounds& gb, const char *scen)
+{
+	ScenarioLoader loader(scen);
+	JPS::Searcher<JPS::BitGrid> search(grid), gbsearch(grid);
+	gbsearch.setGoalBounds(&gb);
+	JPS::PathVector path;
+	size_t nodes = 0, gbnodes = 0, failed = 0;
+	double cost = 0, gbcost = 0;
+	for(unsigned i = 0; i < loader.GetNumExperiments(); ++i)
+	{
+		const Experiment& ex = loader.GetNthExperiment(i);
+		const JPS::Position start = JPS::Pos(ex.GetStartX(), ex.GetStartY());
+		const JPS::Position end = JPS::Pos(ex.GetGoalX(), ex.GetGoalY());
+
+		path.clear();
+		search.findPath(path, start, end, 0, JPS_Flag_NoGreedy);
+		nodes += search.getNodesExpanded();
+		cost += pathcost(start, path);
+
+		path.clear();
+		if(!gbsearch.findPath(path, start, end, 0, JPS_Flag_NoGreedy))
+			++failed;
+		gbnodes += gbsearch.getNodesExpanded();
+		gbcost += pathcost(start, path);
+	}
+	std::cout << "Nodes expanded: " << nodes << " -> " << gbnodes << std::endl;
+	std::cout << "Total distance: " << cost << " -> " << gbcost << std::endl;
+	if(failed)
+		std::cout << "#### " << failed << " paths not found with goal bounding!" << std::endl;
+	return !!failed;
+}
+
+int main(int argc, char **argv)
+{
+	if(argc < 3)
+	{
+		std::cout << "Usage: " << argv[0] << " file.map out.gb [file.map.scen]" << std::endl;
+		return 2;
+	}
+
+	std::ifstream in(argv[1], std::ios::binary);
+	const std::string text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+	JPS::BitGrid grid;
+	if(!grid.initFromMovingAI(text.c_str(), text.length()))
+	{
+		std::cout << "Failed to load map " << argv[1] << std::endl;
+		return 1;
+	}
+
+	const clock_t t0 = clock();
+	JPS::GoalBounds gb;
+	if(!gb.init(grid, grid.width(), grid.height()))
+	{
+		std::cout << "Out of memory" << std::endl;
+		return 1;
+	}
+	std::cout << "Preprocessing took " << double(clock() - t0) / CLOCKS_PER_SEC << " s" << std::endl;
+
+	std::vector<unsigned char> data(gb.serializedSize());
+	gb.serialize(&data[0]);
+	std::ofstream out(argv[2], std::ios::binary);
+	out.write((const char*)&data[0], data.size());
+	if(!out)
+	{
+		std::cout << "Failed to write " << argv[2] << std::endl;
+		return 1;
+	}
+	std::cout << "Wrote " << data.size() << " bytes to " << argv[2] << std::endl;
+
+	// Make sure the data round-trip
+	JPS::GoalBounds gb2;
+	if(!gb2.deserialize(&data[0], data.size()))
+	{
+		std::cout << "Failed to deserialize" << std::endl;
+		return 1;
+	}
+
+	return argc > 3 ? compare(grid, gb2, argv[3]) : 0;
+}
@@ -6,6 +6,7 @@
 #include <string.h>
 #include <assert.h>
 #include <vector>
+#include <thread>
 
 static const char *data[] =
 {
@@ -57,6 +58,588 @@ struct MyGrid
 	mutable std::vector<std::string> out;
 };
 
+// Linear congruential generator; the tests only need reproducible numbers
+static unsigned nextRandom(unsigned& rng)
+{
+    rng = rng * 1103515245u + 12345u;
+    return rng;
+}
+
+static JPS::Position randomPos(unsigned& rng, unsigned w, unsigned h)
+{
+    const unsigned r = nextRandom(rng);
+    return JPS::Pos((r >> 8) % w, (r >> 20) % h);
+}
+
+// One in 'blocked' cells is blocked (a power of 2)
+static void randomGrid(JPS::BitGrid& grid, unsigned w, unsigned h, unsigned& rng, unsigned blocked)
+{
+    grid.init(w, h);
+    for(unsigned y = 0; y < h; ++y)
+        for(unsigned x = 0; x < w; ++x)
+            grid.set(x, y, ((nextRandom(rng) >> 16) & (blocked - 1)) != 0);
+}
+
+// Works for dense paths and for paths made of waypoints
+static int octileLength(JPS::Position start, const JPS::PathVector& path)
+{
+    int len = 0;
+    for(size_t i = 0; i < path.size(); ++i)
+    {
+        len += JPS::Heuristic::Octile(start, path[i]);
+        start = path[i];
+    }
+    return len;
+}
+
+// Walks the path from waypoint to waypoint, diagonally first, and checks every cell and every diagonal step on the way
+template<typename GRID>
+static bool walkable(const GRID& grid, JPS::Position start, const JPS::PathVector& path, JPS::DiagonalRule rule = JPS::Diagonal_NoTunneling)
+{
+    JPS::Position cur = start;
+    for(size_t i = 0; i < path.size(); ++i)
+        while(cur != path[i])
+        {
+            const int dx = (cur.x < path[i].x) - (path[i].x < cur.x);
+            const int dy = (cur.y < path[i].y) - (path[i].y < cur.y);
+            if(dx && dy)
+            {
+                const bool cx = !!grid(cur.x + dx, cur.y), cy = !!grid(cur.x, cur.y + dy);
+                if(rule == JPS::Diagonal_Never || (rule == JPS::Diagonal_NoCornerCutting ? !(cx && cy) : !(cx || cy)))
+                    return false;
+            }
+            cur.x += dx;
+            cur.y += dy;
+            if(!grid(cur.x, cur.y))
+                return false;
+        }
+    return true;
+}
+
+typedef JPS::SearchPolicy<JPS::Heuristic::OctileCosts> Exact;
+
+// Goal bounding must not change whether a path is found
+static int testGoalBounds(const MyGrid& grid, const JPS::PathVector& waypoints)
+{
+    JPS::GoalBounds gb;
+    if(!gb.init(grid, grid.w, grid.h))
+    {
+        std::cout << "GoalBounds init failed!" << std::endl;
+        return 1;
+    }
+    std::vector<unsigned char> gbdata(gb.serializedSize());
+    gb.serialize(&gbdata[0]);
+    JPS::GoalBounds gb2;
+    if(!gb2.deserialize(&gbdata[0], gbdata.size()))
+    {
+        std::cout << "GoalBounds deserialize failed!" << std::endl;
+        return 1;
+    }
+    JPS::Searcher<MyGrid> search(grid), gbsearch(grid);
+    gbsearch.setGoalBounds(&gb2);
+    size_t nodes = 0, gbnodes = 0;
+    JPS::PathVector path;
+    for(size_t i = 0; i < waypoints.size(); ++i)
+        for(unsigned y = 0; y < grid.h; ++y)
+            for(unsigned x = 0; x < grid.w; ++x)
+                if(grid(x, y))
+                {
+                    path.clear();
+                    const bool found = search.findPath(path, waypoints[i], JPS::Pos(x, y), 0, JPS_Flag_NoGreedy);
+                    const bool gbfound = gbsearch.findPath(path, waypoints[i], JPS::Pos(x, y), 0, JPS_Flag_NoGreedy);
+                    if(found != gbfound)
+                    {
+                        std::cout << "Goal bounding changed result!" << std::endl;
+                        return 1;
+                    }
+                    nodes += search.getNodesExpanded();
+                    gbnodes += gbsearch.getNodesExpanded();
+                }
+    std::cout << "Goal bounding: " << gbdata.size() << " bytes serialized; nodes expanded: " << nodes << " -> " << gbnodes << std::endl;
+    return 0;
+}
+
+// Component map must agree with the searcher, also after changing the grid.
+// Flip cells of a small grid at random; as long as the map isn't dirty it must be exact, otherwise at least conservative.
+static int testComponentMap(unsigned& rng)
+{
+    JPS::BitGrid bg;
+    bg.init(24, 16);
+    JPS::ComponentMap cm;
+    cm.init(bg, bg.width(), bg.height());
+    JPS::Searcher<JPS::BitGrid> bgsearch(bg);
+    unsigned rebuilds = 0;
+    for(unsigned i = 0; i < 2000; ++i)
+    {
+        const unsigned r = nextRandom(rng);
+        const unsigned x = (r >> 8) % bg.width(), y = (r >> 20) % bg.height();
+        bg.set(x, y, !!((r >> 4) & 1));
+        cm.update(bg, x, y);
+        if(cm.isDirty() && !(i % 8))
+        {
+            cm.rebuild(bg);
+            ++rebuilds;
+        }
+        for(unsigned k = 0; k < 8; ++k)
+        {
+            const JPS::Position a = randomPos(rng, bg.width(), bg.height());
+            const JPS::Position b = randomPos(rng, bg.width(), bg.height());
+            if(a == b || !bg(a.x, a.y) || !bg(b.x, b.y))
+                continue;
+            JPS::PathVector path;
+            const bool found = bgsearch.findPath(path, a, b, 0, JPS_Flag_NoGreedy);
+            const bool conn = cm.connected(a, b);
+            if(found ? !conn : (conn && !cm.isDirty()))
+            {
+                std::cout << "Component map disagrees with search!" << std::endl;
+                return 1;
+            }
+        }
+    }
+    std::cout << "Component map: ok, " << rebuilds << " rebuilds" << std::endl;
+    return 0;
+}
+
+// Differently configured searchers side by side. With exact costs, JPS and A* must find paths of the same length,
+// and stricter diagonal rules can only make paths longer.
+static int testPolicies(const MyGrid& grid, const JPS::PathVector& waypoints)
+{
+    JPS::Searcher<MyGrid, JPS::NodeMap, JPS::OpenList, JPS::SearchPolicy<JPS::Heuristic::OctileCosts, JPS::Expand_JPS> > jpsOctile(grid);
+    JPS::Searcher<MyGrid, JPS::NodeMap, JPS::OpenList, JPS::SearchPolicy<JPS::Heuristic::OctileCosts, JPS::Expand_AStar> > astarOctile(grid);
+    JPS::Searcher<MyGrid, JPS::NodeMap, JPS::OpenList,
+        JPS::SearchPolicy<JPS::Heuristic::OctileCosts, JPS::Expand_AStar, JPS::Diagonal_NoCornerCutting> > astarNoCorners(grid);
+    JPS::Searcher<MyGrid, JPS::NodeMap, JPS::OpenList,
+        JPS::SearchPolicy<JPS::Heuristic::ManhattanCosts, JPS::Expand_AStar, JPS::Diagonal_Never> > astarStraight(grid);
+    const JPS::DiagonalRule rules[4] = { JPS::Diagonal_NoTunneling, JPS::Diagonal_NoTunneling, JPS::Diagonal_NoCornerCutting, JPS::Diagonal_Never };
+    for(size_t i = 1; i < waypoints.size(); ++i)
+    {
+        const JPS::Position a = waypoints[i-1], b = waypoints[i];
+        JPS::PathVector p[4];
+        if(!jpsOctile.findPath(p[0], a, b, 1)
+            || !astarOctile.findPath(p[1], a, b, 1)
+            || !astarNoCorners.findPath(p[2], a, b, 1)
+            || !astarStraight.findPath(p[3], a, b, 1))
+        {
+            std::cout << "Policy search: Path not found!" << std::endl;
+            return 1;
+        }
+        // A* must stop after the given number of steps, too
+        if(astarOctile.findPathInit(a, b, JPS_Flag_NoGreedy) != JPS_NEED_MORE_STEPS || astarOctile.findPathStep(8) != JPS_NEED_MORE_STEPS)
+        {
+            std::cout << "Policy search: A* ignores the step limit!" << std::endl;
+            return 1;
+        }
+        int len[4];
+        for(unsigned k = 0; k < 4; ++k)
+        {
+            if(!walkable(grid, a, p[k], rules[k]))
+            {
+                std::cout << "Policy search: Diagonal rule violated!" << std::endl;
+                return 1;
+            }
+            len[k] = octileLength(a, p[k]);
+        }
+        if(len[0] != len[1] || len[2] < len[1] || len[3] < len[2])
+        {
+            std::cout << "Policy search: Unexpected path lengths " << len[0] << ", " << len[1] << ", " << len[2] << ", " << len[3] << std::endl;
+            return 1;
+        }
+    }
+    std::cout << "Policy search: ok" << std::endl;
+    return 0;
+}
+
+// Searching for the nearest of many goals must find a path as short as the shortest of all single searches
+static int testNearest(unsigned& rng)
+{
+    JPS::BitGrid rg;
+    randomGrid(rg, 32, 24, rng, 4);
+    JPS::Searcher<JPS::BitGrid, JPS::NodeMap, JPS::OpenList, Exact> uni(rg);
+    unsigned nearestpaths = 0;
+    for(unsigned i = 0; i < 200; ++i)
+    {
+        const JPS::Position s = randomPos(rng, rg.width(), rg.height());
+        JPS::Position goals[12];
+        const unsigned ngoals = 1 + i % 12;
+        int best = -1;
+        for(unsigned k = 0; k < ngoals; ++k)
+        {
+            goals[k] = randomPos(rng, rg.width(), rg.height());
+            JPS::PathVector p1;
+            if(uni.findPath(p1, s, goals[k], 0, JPS_Flag_NoGreedy))
+            {
+                const int len = octileLength(s, p1);
+                if(best < 0 || len < best)
+                    best = len;
+            }
+        }
+        JPS::PathVector p2;
+        const bool found = uni.findPathToNearest(p2, s, goals, ngoals, i & 1);
+        const JPS::Position last = p2.empty() ? s : p2.back();
+        if(found != (best >= 0) || (found && (octileLength(s, p2) != best || !walkable(rg, s, p2) || std::find(goals, goals + ngoals, last) == goals + ngoals)))
+        {
+            std::cout << "Nearest goal search differs!" << std::endl;
+            return 1;
+        }
+        nearestpaths += found;
+    }
+    std::cout << "Nearest goal search: ok, " << nearestpaths << " paths" << std::endl;
+    return 0;
+}
+
+// Costs to many targets from one search must match single searches, and so must the paths
+static int testCostsToMany(unsigned& rng)
+{
+    JPS::BitGrid rg;
+    randomGrid(rg, 32, 24, rng, 4);
+    JPS::Searcher<JPS::BitGrid, JPS::NodeMap, JPS::OpenList, Exact> uni(rg);
+    unsigned manycosts = 0;
+    for(unsigned i = 0; i < 20; ++i)
+    {
+        JPS::Position targets[30];
+        JPS::ScoreType costs[30];
+        const JPS::Position s = randomPos(rng, rg.width(), rg.height());
+        for(unsigned k = 0; k < 30; ++k)
+            targets[k] = randomPos(rng, rg.width(), rg.height());
+        if(!uni.findCostsToMany(s, targets, 30, costs))
+        {
+            std::cout << "findCostsToMany failed!" << std::endl;
+            return 1;
+        }
+        for(unsigned k = 0; k < 30; ++k)
+        {
+            JPS::PathVector p2;
+            const JPS_Result res = uni.findPathFinishTo(p2, targets[k], k & 1);
+            if(costs[k] == JPS::noscore ? res != JPS_NO_PATH
+                : (res == JPS_NO_PATH || octileLength(s, p2) != costs[k] || !walkable(rg, s, p2) || (!p2.empty() && p2.back() != targets[k])))
+            {
+                std::cout << "findPathFinishTo differs!" << std::endl;
+                return 1;
+            }
+        }
+        for(unsigned k = 0; k < 30; ++k)
+        {
+            JPS::PathVector p1;
+            const bool found = uni.findPath(p1, s, targets[k], 0, JPS_Flag_NoGreedy);
+            if(found != (costs[k] != JPS::noscore) || (found && octileLength(s, p1) != costs[k]))
+            {
+                std::cout << "findCostsToMany differs!" << std::endl;
+                return 1;
+            }
+            manycosts += found;
+        }
+    }
+    std::cout << "Costs to many targets: ok, " << manycosts << " costs" << std::endl;
+    return 0;
+}
+
+static bool sameGraph(const JPS::HierSearcher<JPS::BitGrid>& a, const JPS::HierSearcher<JPS::BitGrid>& b)
+{
+    const JPS::SizeT n = a.getNumEntrances();
+    if(n != b.getNumEntrances())
+        return false;
+    for(JPS::SizeT i = 0; i < n; ++i)
+    {
+        if(a.getEntrance(i) != b.getEntrance(i))
+            return false;
+        for(JPS::SizeT k = 0; k < n; ++k)
+            if(a.getEntranceCost(i, k) != b.getEntranceCost(i, k))
+                return false;
+    }
+    return true;
+}
+
+// Hierarchical search must find a path whenever there is one, also after changing the grid,
+// and repairing the changed clusters must give the same graph as building it from scratch.
+static int testHier(unsigned& rng)
+{
+    JPS::BitGrid hg;
+    randomGrid(hg, 44, 36, rng, 8);
+    JPS::HierSearcher<JPS::BitGrid> hier(hg);
+    if(!hier.init(hg.width(), hg.height(), 8))
+    {
+        std::cout << "HierSearcher init failed!" << std::endl;
+        return 1;
+    }
+    JPS::Searcher<JPS::BitGrid> hgsearch(hg);
+    unsigned hierpaths = 0;
+    for(unsigned i = 0; i < 300; ++i)
+    {
+        const unsigned r = nextRandom(rng);
+        const unsigned x = (r >> 8) % hg.width(), y = (r >> 20) % hg.height();
+        hg.set(x, y, !!((r >> 4) & 3));
+        hier.update(x, y);
+        if(!(i % 10))
+        {
+            JPS::HierSearcher<JPS::BitGrid> fresh(hg);
+            if(!fresh.init(hg.width(), hg.height(), 8) || !hier.repair() || !sameGraph(fresh, hier))
+            {
+                std::cout << "HierSearcher repair differs!" << std::endl;
+                return 1;
+            }
+        }
+        for(unsigned k = 0; k < 4; ++k)
+        {
+            const JPS::Position a = randomPos(rng, hg.width(), hg.height());
+            const JPS::Position b = randomPos(rng, hg.width(), hg.height());
+            JPS::PathVector p1, p2;
+            const bool found = hgsearch.findPath(p1, a, b, 0);
+            // Refine one part at a time, as a game would while moving along
+            JPS_Result res = hier.findPathInit(a, b);
+            while(res == JPS_FOUND_PATH || res == JPS_NEED_MORE_STEPS)
+            {
+                res = hier.findPathFinish(p2, 1, 1);
+                if(res == JPS_FOUND_PATH)
+                    break;
+            }
+            const JPS::Position last = p2.empty() ? a : p2.back();
+            if(found != (res == JPS_FOUND_PATH || res == JPS_EMPTY_PATH) || !walkable(hg, a, p2) || (found && last != b))
+            {
+                std::cout << "HierSearcher differs!" << std::endl;
+                return 1;
+            }
+            hierpaths += found;
+        }
+    }
+    std::cout << "Hierarchical search: ok, " << hierpaths << " paths" << std::endl;
+    return 0;
+}
+
+// Incremental replanning must keep the path as short as searching from scratch while the grid changes
+// under a unit walking along its path, and repairing must expand fewer nodes than searching again.
+static int testReplan(unsigned& rng)
+{
+    JPS::BitGrid dg;
+    randomGrid(dg, 40, 30, rng, 8);
+    JPS::ReplanSearcher<JPS::BitGrid> replan(dg);
+    JPS::Searcher<JPS::BitGrid, JPS::NodeMap, JPS::OpenList, Exact> dgsearch(dg);
+    unsigned replans = 0;
+    size_t repairnodes = 0, freshnodes = 0;
+    for(unsigned i = 0; i < 50; ++i)
+    {
+        JPS::Position pos = randomPos(rng, dg.width(), dg.height());
+        const JPS::Position b = randomPos(rng, dg.width(), dg.height());
+        dg.set(pos.x, pos.y, true);
+        dg.set(b.x, b.y, true);
+        JPS::PathVector p;
+        if(!replan.findPath(p, pos, b, 1))
+            continue; // walled in
+        for(size_t j = 0; pos != b; ++j)
+        {
+            if(j >= p.size())
+            {
+                std::cout << "ReplanSearcher path incomplete!" << std::endl;
+                return 1;
+            }
+            pos = p[j];
+            replan.moveStart(pos);
+            if(j % 3 || pos == b)
+                continue;
+            // Block or open a few cells close to the unit; also on its path
+            for(unsigned k = 0; k < 3; ++k)
+            {
+                const unsigned r = nextRandom(rng);
+                const JPS::Position c = k ? JPS::Pos(pos.x + (r >> 8) % 9 - 4, pos.y + (r >> 20) % 9 - 4) : p[std::min<size_t>(j + 2, p.size() - 1)];
+                if(c == pos || c == b || c.x >= dg.width() || c.y >= dg.height())
+                    continue;
+                dg.set(c.x, c.y, !dg(c.x, c.y));
+                replan.notifyCellChanged(c.x, c.y);
+            }
+            JPS::PathVector p1;
+            const bool found = dgsearch.findPath(p1, pos, b, 0, JPS_Flag_NoGreedy);
+            JPS_Result res = replan.findPathStep(0);
+            repairnodes += replan.getNodesExpanded();
+            JPS::ReplanSearcher<JPS::BitGrid> fresh(dg);
+            JPS::PathVector p2;
+            fresh.findPath(p2, pos, b, 1);
+            freshnodes += fresh.getNodesExpanded();
+            if(found != (res == JPS_FOUND_PATH) || (found && replan.getPathCost() != octileLength(pos, p1)))
+            {
+                std::cout << "ReplanSearcher differs!" << std::endl;
+                return 1;
+            }
+            if(!found)
+                break;
+            p.clear();
+            j = size_t(-1);
+            if(replan.findPathFinish(p, 1) != JPS_FOUND_PATH || p.empty() || p.back() != b || !walkable(dg, pos, p))
+            {
+                std::cout << "ReplanSearcher path invalid!" << std::endl;
+                return 1;
+            }
+            ++replans;
+        }
+    }
+    if(repairnodes >= freshnodes)
+    {
+        std::cout << "ReplanSearcher repairs expand too much!" << std::endl;
+        return 1;
+    }
+    std::cout << "Replanning: ok, " << replans << " repairs, nodes expanded " << freshnodes << " -> " << repairnodes << std::endl;
+    return 0;
+}
+
+// Blocks the two cells next to a cached diagonal step, each in a region the path doesn't enter.
+// The cache must not return the old path anymore.
+template<typename POLICY>
+static bool cachedCornerOk(JPS::DiagonalRule rule)
+{
+    JPS::BitGrid g;
+    g.init(8, 8);
+    for(unsigned y = 0; y < g.height(); ++y)
+        for(unsigned x = 0; x < g.width(); ++x)
+            g.set(x, y, true);
+    typedef JPS::Searcher<JPS::BitGrid, JPS::NodeMap, JPS::OpenList, POLICY> Search;
+    Search search(g);
+    JPS::PathCache<Search> cache(search);
+    const JPS::Position a = JPS::Pos(0, 0), b = JPS::Pos(7, 7);
+    JPS::PathVector p1, p2;
+    if(!cache.init(g.width(), g.height(), 4) || !cache.findPath(p1, a, b, 1))
+        return false;
+    // The path goes straight along the diagonal, from region 0 to region 3 via (3, 3) -> (4, 4)
+    g.set(4, 3, false);
+    cache.update(4, 3);
+    g.set(3, 4, false);
+    cache.update(3, 4);
+    return cache.findPath(p2, a, b, 1) && walkable(g, a, p2, rule) && p2.back() == b;
+}
+
+// Cached paths must stay walkable while the grid changes, and a cached failure must still be one.
+// The memory cap is small enough to evict some of the paths.
+static int testPathCache(unsigned& rng)
+{
+    JPS::BitGrid cg;
+    randomGrid(cg, 48, 40, rng, 4);
+    JPS::Searcher<JPS::BitGrid> cgsearch(cg), cgcheck(cg);
+    JPS::PathCache<JPS::Searcher<JPS::BitGrid> > cache(cgsearch);
+    cache.init(cg.width(), cg.height(), 8, 3072);
+    JPS::Position ends[24];
+    for(unsigned i = 0; i < 24; ++i)
+        ends[i] = randomPos(rng, cg.width(), cg.height());
+    for(unsigned i = 0; i < 3000; ++i)
+    {
+        const unsigned r = nextRandom(rng);
+        const unsigned k = (r >> 8) % 12;
+        if(!(i % 50))
+        {
+            const unsigned x = (r >> 12) % cg.width(), y = (r >> 20) % cg.height();
+            cg.set(x, y, !cg(x, y));
+            cache.update(x, y);
+        }
+        JPS::PathVector p1, p2;
+        const bool found = cache.findPath(p1, ends[k], ends[k + 12], i & 1);
+        const JPS::Position last = p1.empty() ? ends[k] : p1.back();
+        if(found != cgcheck.findPath(p2, ends[k], ends[k + 12], i & 1) || !walkable(cg, ends[k], p1) || (found && last != ends[k + 12]))
+        {
+            std::cout << "PathCache path invalid!" << std::endl;
+            return 1;
+        }
+    }
+    if(cache.getHits() <= cache.getMisses() || cache.getNumEntries() >= 24 || cache.getTotalMemoryInUse() > 8192)
+    {
+        std::cout << "PathCache statistics wrong!" << std::endl;
+        return 1;
+    }
+    if(!cachedCornerOk<JPS::SearchPolicy<> >(JPS::Diagonal_NoTunneling)
+        || !cachedCornerOk<JPS::SearchPolicy<JPS::Heuristic::DefaultCosts, JPS::Expand_AStar, JPS::Diagonal_NoCornerCutting> >(JPS::Diagonal_NoCornerCutting))
+    {
+        std::cout << "PathCache kept a path past blocked corners!" << std::endl;
+        return 1;
+    }
+    std::cout << "Path cache: ok, " << cache.getHits() << " hits, " << cache.getMisses() << " misses, " << cache.getNumEntries() << " paths cached" << std::endl;
+    return 0;
+}
+
+typedef JPS::FlowField<JPS::BitGrid> Flow;
+
+// Follows the directions from (x, y) until there are none or the walk leaves the given rectangle
+static void followFlow(JPS::PathVector& path, JPS::Position cur, const unsigned char *dir, unsigned x0, unsigned y0, unsigned w, unsigned h)
+{
+    for(unsigned k = 0; k < w * h && cur.x - x0 < w && cur.y - y0 < h && dir[(cur.y - y0) * w + cur.x - x0] != Flow::NoDir; ++k)
+    {
+        cur = Flow::getStep(cur, dir[(cur.y - y0) * w + cur.x - x0]);
+        path.push_back(cur);
+    }
+}
+
+// Flow field costs must match single searches, following the directions must get to the goal at that cost,
+// and building on several threads must give the same costs.
+static int testFlowField(unsigned& rng)
+{
+    JPS::BitGrid fg;
+    randomGrid(fg, 70, 50, rng, 4);
+    const JPS::Position goal = JPS::Pos(33, 21);
+    fg.set(goal.x, goal.y, true);
+    Flow flow(fg);
+    const unsigned fw = fg.width(), fh = fg.height();
+    std::vector<JPS::ScoreType> fdist(fw * fh), fdist2(fw * fh);
+    std::vector<unsigned char> fdir(fw * fh), fdir2(fw * fh);
+    if(flow.build(goal, &fdist[0], &fdir[0], 0, 0, fw, fh) != JPS_FOUND_PATH)
+    {
+        std::cout << "FlowField failed!" << std::endl;
+        return 1;
+    }
+    JPS::Searcher<JPS::BitGrid, JPS::NodeMap, JPS::OpenList, Exact> fgsearch(fg);
+    unsigned flowcells = 0;
+    for(unsigned y = 0; y < fh; ++y)
+        for(unsigned x = 0; x < fw; ++x)
+        {
+            const JPS::Position s = JPS::Pos(x, y);
+            JPS::PathVector p1;
+            const bool found = fg(x, y) && fgsearch.findPath(p1, s, goal, 0, JPS_Flag_NoGreedy);
+            const int len = octileLength(s, p1);
+            JPS::PathVector walk;
+            followFlow(walk, s, &fdir[0], 0, 0, fw, fh);
+            const JPS::ScoreType d = fdist[y * fw + x];
+            if(found != (d != JPS::noscore) || (found && (d != len || octileLength(s, walk) != len || !walkable(fg, s, walk) || (walk.empty() ? s : walk.back()) != goal)))
+            {
+                std::cout << "FlowField differs!" << std::endl;
+                return 1;
+            }
+            flowcells += found;
+        }
+    if(flow.buildInit(goal, &fdist2[0], &fdir2[0], 0, 0, fw, fh, 3, 8) != JPS_NEED_MORE_STEPS)
+    {
+        std::cout << "FlowField failed!" << std::endl;
+        return 1;
+    }
+    JPS_Result res;
+    do
+    {
+        for(unsigned color = 0; color < 4; ++color)
+        {
+            std::thread t1([&]() { flow.buildPass(color, 1); }), t2([&]() { flow.buildPass(color, 2); });
+            flow.buildPass(color, 0);
+            t1.join();
+            t2.join();
+        }
+        res = flow.buildSync();
+    }
+    while(res == JPS_NEED_MORE_STEPS);
+    const unsigned flowpasses = flow.getPasses();
+    if(res != JPS_FOUND_PATH || fdist != fdist2)
+    {
+        std::cout << "FlowField on threads differs!" << std::endl;
+        return 1;
+    }
+    // Sub-rectangle: Never leaves it
+    const unsigned sx0 = 20, sy0 = 10, sw = 30, sh = 25;
+    flow.build(goal, &fdist2[0], &fdir2[0], sx0, sy0, sw, sh);
+    for(unsigned i = 0; i < sw * sh; ++i)
+    {
+        const JPS::Position s = JPS::Pos(sx0 + i % sw, sy0 + i / sw);
+        JPS::PathVector walk;
+        followFlow(walk, s, &fdir2[0], sx0, sy0, sw, sh);
+        const JPS::Position last = walk.empty() ? s : walk.back();
+        if(fdist2[i] != JPS::noscore && (last != goal || octileLength(s, walk) != fdist2[i] || fdist2[i] < fdist[s.y * fw + s.x]))
+        {
+            std::cout << "FlowField in sub-rectangle differs!" << std::endl;
+            return 1;
+        }
+    }
+    std::cout << "Flow field: ok, " << flowcells << " cells, " << flowpasses << " passes on 3 threads" << std::endl;
+    return 0;
+}
 
 int main(int argc, char **argv)
 {
@@ -107,5 +690,17 @@ int main(int argc, char **argv)
 	std::cout << "Search steps:   " << totalsteps << std::endl;
     std::cout << "Nodes expanded: " << totalnodes << std::endl;
     std::cout << "Memory used: " << search.getTotalMemoryInUse() << " bytes" << std::endl;
+
+	unsigned rng = 12345;
+	if(testGoalBounds(grid, waypoints)
+		|| testComponentMap(rng)
+		|| testPolicies(grid, waypoints)
+		|| testNearest(rng)
+		|| testCostsToMany(rng)
+		|| testHier(rng)
+		|| testReplan(rng)
+		|| testPathCache(rng)
+		|| testFlowField(rng))
+		return 1;
 	return 0;
 }
@@ -1,13 +1,23 @@
 // How to use:
 // Set working directory to test/jps (= where this file resides), then run:
-//  ./testjps maps/*.scen
-// for a quick benchmark and correctness test.
+//  ./testjps2 maps/*.scen
+// for a quick benchmark and correctness test. ./testjps2_default does the same with the default costs.
 
+// Exact costs, so that path lengths can be checked against the optimal lengths in the scenario files.
+// Built with TEST_DEFAULT_COSTS (the testjps2_default target), this tests the default costs instead,
+// skipping the checks that need optimal paths.
+#ifndef TEST_DEFAULT_COSTS
+#define JPS_OCTILE
+static const bool exactCosts = true;
+#else
+static const bool exactCosts = false;
+#endif
 #include "jps.hh"
 
 #include <iostream>
 #include "ScenarioLoader.h"
 #include <fstream>
+#include <iterator>
 #include <stdlib.h>
 #include <assert.h>
 #include <math.h>
@@ -20,49 +30,17 @@ static void die(const char *msg)
 	abort();
 }
 
-struct MapGrid
+static void loadMap(JPS::BitGrid& grid, const char *file)
 {
-	MapGrid(const char *file)
-	{
-		std::ifstream in(file);
-		if(!in)
-			die(file);
-
-		std::string s;
-		std::getline(in, s);
-		in >> s >> h;
-		in >> s >> w;
-		in >> s;
-
-		while(in >> s)
-			if(s.length() == w)
-				lines.push_back(s);
-
-		if(h != lines.size())
-			die("Wrong number of lines");
-
-        std::cout << "[" << file << "] W: " << w << "; H: " << h << "; Total cells: " << (w*h) << std::endl;
-	}
-
-	bool operator()(unsigned x, unsigned y) const
-	{
-		if(x < w && y < h)
-		{
-			const char c = lines[y][x];
-			switch(c)
-			{
-				case '.':
-				case 'G':
-				case 'S':
-					return true;
-			}
-		}
-		return false;
-	}
+	std::ifstream in(file, std::ios::binary);
+	if(!in)
+		die(file);
+	const std::string text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+	if(!grid.initFromMovingAI(text.c_str(), text.length()))
+		die("Failed to parse map");
 
-	unsigned w, h;
-	std::vector<std::string> lines;
-};
+	std::cout << "[" << file << "] W: " << grid.width() << "; H: " << grid.height() << "; Total cells: " << (grid.width()*grid.height()) << std::endl;
+}
 
 static double pathcost(unsigned startx, unsigned starty, const JPS::PathVector& path)
 {
@@ -86,15 +64,64 @@ static double pathcost(unsigned startx, unsigned starty, const JPS::PathVector&
 	return accu;
 }
 
+// Every segment must be straight or diagonal, and every step must be a legal move
+static bool pathvalid(const JPS::BitGrid& grid, JPS::Position last, const JPS::PathVector& path)
+{
+	for(size_t i = 0; i < path.size(); ++i)
+	{
+		const JPS::Position p = path[i];
+		int dx = int(p.x - last.x);
+		int dy = int(p.y - last.y);
+		if((dx && dy && abs(dx) != abs(dy)) || (!dx && !dy))
+			return false;
+		dx = (dx > 0) - (dx < 0);
+		dy = (dy > 0) - (dy < 0);
+		while(last != p)
+		{
+			if(dx && dy && !grid(last.x + dx, last.y) && !grid(last.x, last.y + dy))
+				return false;
+			last.x += dx;
+			last.y += dy;
+			if(!grid(last.x, last.y))
+				return false;
+		}
+	}
+	return true;
+}
+
 double runScenario(const char *file)
 {
 	ScenarioLoader loader(file);
 	if(!loader.GetNumExperiments())
 		die(file);
-	MapGrid grid(loader.GetNthExperiment(0).GetMapName());
-	double sum = 0;
+	JPS::BitGrid grid;
+	loadMap(grid, loader.GetNthExperiment(0).GetMapName());
+	double sum = 0, bcost = 0;
 	JPS::PathVector path;
-	JPS::Searcher<MapGrid> search(grid);
+	JPS::Searcher<JPS::BitGrid> search(grid);
+	JPS::Searcher<JPS::BitGrid, JPS::DenseNodeMap> dsearch(grid);
+	dsearch.getNodeMap().init(grid.width(), grid.height());
+	JPS::PathVector dpath;
+	JPS::JumpTable jt;
+	if(!jt.init(grid, grid.width(), grid.height()))
+		die("Failed to build jump table");
+	JPS::Searcher<JPS::BitGrid> jsearch(grid);
+	jsearch.setJumpTable(&jt);
+	JPS::Searcher<JPS::BitGrid, JPS::NodeMap, JPS::BucketOpenList> bsearch(grid);
+	size_t nodes = 0;
+	JPS::Searcher<JPS::BitGrid> wsearch(grid), asearch(grid);
+	wsearch.setWeight(110);
+	asearch.setWeight(300);
+	asearch.setAnytime(50);
+	size_t wnodes = 0;
+	double wcost = 0;
+	JPS::HierSearcher<JPS::BitGrid> hier(grid);
+	if(!hier.init(grid.width(), grid.height(), 32))
+		die("Failed to build cluster graph");
+	double hcost = 0;
+	JPS::ComponentMap cm;
+	if(!cm.init(grid, grid.width(), grid.height()))
+		die("Failed to build component map");
 	for(unsigned i = 0; i < loader.GetNumExperiments(); ++i)
 	{
 		const Experiment& ex = loader.GetNthExperiment(i);
@@ -129,10 +156,78 @@ double runScenario(const char *file)
 			continue;
 		}
 
+		if(!cm.connected(startpos, endpos))
+			die("Component map says not connected!");
+
 		assert((path.empty() && startpos == endpos) || path.back() == endpos);
 
 		// Starting position is NOT included in vector
 		double cost = pathcost(ex.GetStartX(), ex.GetStartY(), path);
+
+		// The scenario files don't allow cutting corners, so the path may be shorter, but never longer.
+		// (Some scenario files round to two decimals, and the searcher uses sqrt(2) ~ 1.414, hence the tolerance)
+		if(exactCosts && cost > ex.GetDistance() * 1.0005 + 0.01)
+		{
+			printf("#### [%s:%d] Path length %f, expected %f\n", file, i, cost, ex.GetDistance());
+			die("Path not optimal!");
+		}
+
+		// Must find the same path with the dense node map
+		dpath.clear();
+		if(!dsearch.findPath(dpath, startpos, endpos, 0) || pathcost(ex.GetStartX(), ex.GetStartY(), dpath) != cost)
+			die("DenseNodeMap path differs!");
+
+		// And with precomputed jumps
+		dpath.clear();
+		if(!jsearch.findPath(dpath, startpos, endpos, 0) || pathcost(ex.GetStartX(), ex.GetStartY(), dpath) != cost)
+			die("JumpTable path differs!");
+
+		// The bucket queue breaks ties differently, so the path may differ, and its cost too unless costs are exact
+		dpath.clear();
+		if(!bsearch.findPath(dpath, startpos, endpos, 0))
+			die("BucketOpenList path not found!");
+		bcost += pathcost(ex.GetStartX(), ex.GetStartY(), dpath);
+
+		nodes += search.getNodesExpanded();
+
+		// Weighted search must stay within its bound (which only holds if the estimate doesn't overestimate)
+		dpath.clear();
+		if(!wsearch.findPath(dpath, startpos, endpos, 0, JPS_Flag_NoGreedy))
+			die("Weighted search: Path not found!");
+		const double wc = pathcost(ex.GetStartX(), ex.GetStartY(), dpath);
+		if(exactCosts && wc > cost * 1.1 + 0.01)
+			die("Weighted search: Path too long!");
+		wcost += wc;
+		wnodes += wsearch.getNodesExpanded();
+
+		// Anytime search: Every path must be within the bound of its round, and the last one optimal
+		res = asearch.findPathInit(startpos, endpos, JPS_Flag_NoGreedy);
+		for(;;)
+		{
+			while(res == JPS_NEED_MORE_STEPS)
+				res = asearch.findPathStep(10000);
+			if(res == JPS_EMPTY_PATH)
+				break;
+			dpath.clear();
+			if(res != JPS_FOUND_PATH || asearch.findPathFinish(dpath, 0) != JPS_FOUND_PATH)
+				die("Anytime search: Path not found!");
+			const double ac = pathcost(ex.GetStartX(), ex.GetStartY(), dpath);
+			if(exactCosts && ac > cost * asearch.getBound() / 100.0 + 0.01)
+				die("Anytime search: Path too long!");
+			if(asearch.getBound() == 100)
+			{
+				if(exactCosts && fabs(ac - cost) > 0.001 * cost + 0.01)
+					die("Anytime search: Final path not optimal!");
+				break;
+			}
+			res = asearch.findPathStep(10000);
+		}
+
+		// Hierarchical search finds somewhat longer paths, but never fails
+		dpath.clear();
+		if(!hier.findPath(dpath, startpos, endpos, 0) || !pathvalid(grid, startpos, dpath))
+			die("Hierarchical search: Path not found!");
+		hcost += pathcost(ex.GetStartX(), ex.GetStartY(), dpath);
 #if 0
 		//if(cost > ex.GetDistance()+0.5f)
 			printf("[%s] [%s:%d] Path len: %.3f (%.3f); Diff: %.3f; Steps: %u; Nodes: %u; Runs: %u\n",
@@ -144,7 +239,10 @@ double runScenario(const char *file)
 
 		sum += cost;
 	}
-    printf("Done. Req. memory: %u KB\n", (unsigned)search.getTotalMemoryInUse() / 1024);
+    printf("Done. Req. memory: %u KB; bucket queue distance: %+.2f%%\n",
+        (unsigned)search.getTotalMemoryInUse() / 1024, sum ? 100.0 * (bcost - sum) / sum : 0.0);
+    printf("Weight 1.1: nodes %u -> %u, distance %+.2f%%\n", (unsigned)nodes, (unsigned)wnodes, sum ? 100.0 * (wcost - sum) / sum : 0.0);
+    printf("Hierarchical: %u entrances, distance %+.2f%%\n", (unsigned)hier.getNumEntrances(), sum ? 100.0 * (hcost - sum) / sum : 0.0);
 	return sum;
 }
 
@@ -0,0 +1,31 @@
+-- Classic binary-trees: many short-lived small tables, plus a few long-lived ones
+local function bottomUpTree(depth)
+    if depth > 0 then
+        depth = depth - 1
+        return { bottomUpTree(depth), bottomUpTree(depth) }
+    end
+    return {}
+end
+
+local function itemCheck(tree)
+    if tree[1] then
+        return 1 + itemCheck(tree[1]) + itemCheck(tree[2])
+    end
+    return 1
+end
+
+local N = 14
+local mindepth, maxdepth = 4, N
+local stretch = itemCheck(bottomUpTree(maxdepth + 1))
+assert(stretch == 2 ^ (maxdepth + 2) - 1)
+
+local longlived = bottomUpTree(maxdepth)
+for depth = mindepth, maxdepth, 2 do
+    local iters = 2 ^ (maxdepth - depth + mindepth)
+    local check = 0
+    for i = 1, iters do
+        check = check + itemCheck(bottomUpTree(depth))
+    end
+    assert(check == iters * (2 ^ (depth + 1) - 1))
+end
+assert(itemCheck(longlived) == 2 ^ (maxdepth + 1) - 1)
@@ -0,0 +1,35 @@
+-- Closure-heavy code: function factories, shared and private upvalues, iterators
+local function counter()
+    local n = 0
+    return function() n = n + 1; return n end
+end
+
+local function compose(f, g)
+    return function(...) return f(g(...)) end
+end
+
+local function range(a, b)
+    local i = a - 1
+    return function()
+        i = i + 1
+        if i <= b then return i end
+    end
+end
+
+local sum = 0
+for round = 1, 200 do
+    local fs = {}
+    for i = 1, 1000 do
+        local c = counter()
+        local add = function(x) return x + i end
+        fs[i] = compose(add, c)
+    end
+    for i = 1, 1000 do
+        sum = sum + fs[i]()
+    end
+    for v in range(1, 500) do
+        local sq = function() return v * v end
+        sum = sum + sq()
+    end
+end
+assert(sum > 0)
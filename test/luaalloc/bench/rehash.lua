@@ -0,0 +1,28 @@
+-- Table rehash storms: tables growing through many sizes, in the array and the hash part
+local keep = {}
+for round = 1, 10 do
+    local arr, hash, mixed = {}, {}, {}
+    for i = 1, 20000 do
+        arr[i] = i
+        hash["k" .. i] = i
+        mixed[i * 3] = i
+        mixed[-i] = i
+    end
+    -- Shrink by removing, then regrow with different keys
+    for i = 1, 20000, 2 do
+        hash["k" .. i] = nil
+    end
+    for i = 1, 10000 do
+        hash[i + 0.5] = i
+    end
+    -- Lots of small tables that each grow a few times
+    for i = 1, 2000 do
+        local t = {}
+        for j = 1, 33 do
+            t[j] = j
+            t["f" .. j] = j
+        end
+        keep[(round * i) % 500 + 1] = t
+    end
+    assert(#arr == 20000)
+end
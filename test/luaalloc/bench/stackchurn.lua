@@ -0,0 +1,27 @@
+-- Stand-in for coroutine churn (minilua has no coroutine library):
+-- deep recursion and error unwinding make Lua grow and shrink its stack and CallInfo arrays,
+-- which is the same kind of mid-size, frequently resized allocation a coroutine's stack is.
+local function deep(n, ...)
+    if n == 0 then
+        return select and select("#", ...) or #{...}
+    end
+    return deep(n - 1, n, ...)
+end
+
+local function thrower(n)
+    if n == 0 then error({ code = 42 }) end
+    local t = { n }
+    return thrower(n - 1) + t[1]
+end
+
+local total = 0
+for round = 1, 3000 do
+    total = total + deep(50 + round % 150)
+    local ok, e = pcall(thrower, 20 + round % 80)
+    assert(not ok and e.code == 42)
+    local env = setmetatable({}, { __index = _G })
+    local f = loadstring("return " .. round .. " + 1")
+    setfenv(f, env)
+    total = total + f()
+end
+assert(total > 0)
@@ -0,0 +1,18 @@
+-- String building: naive concatenation, buffers + table.concat, formatting, pattern replacement
+local parts = {}
+for round = 1, 40 do
+    local s = ""
+    for i = 1, 2000 do
+        s = s .. (i % 10)
+    end
+    assert(#s == 2000)
+
+    local buf = {}
+    for i = 1, 5000 do
+        buf[#buf + 1] = string.format("%d:%s;", i, string.rep("x", i % 17))
+    end
+    local joined = table.concat(buf)
+    local replaced = joined:gsub("x+", function(m) return #m end)
+    parts[round % 8 + 1] = replaced:upper():sub(1, 1000)
+end
+assert(#table.concat(parts) == 8000)
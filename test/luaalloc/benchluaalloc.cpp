@@ -0,0 +1,171 @@
+// End-to-end allocator benchmark: Runs allocation-heavy Lua workloads
+// with LuaAlloc and with a plain realloc()/free() allocator, and compares.
+// How to use:
+// Set working directory to test/luaalloc (= where this file resides), then run:
+//  ./benchluaalloc
+// or pass specific Lua files to run instead of the default set in bench/.
+// For meaningful numbers, build in release mode.
+
+#include "luaalloc.h"
+
+typedef void *(*lua_Alloc)(void *ud, void *ptr, size_t osize, size_t nsize);
+extern "C" int runlua(int argc, const char*const*argv, lua_Alloc alloc, void *ud);
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <chrono>
+
+typedef std::chrono::steady_clock Clock;
+
+static const char *defaultWorkloads[] =
+{
+    "bench/binarytrees.lua",
+    "bench/strings.lua",
+    "bench/rehash.lua",
+    "bench/closures.lua",
+    "bench/stackchurn.lua",
+    NULL
+};
+
+// Wraps an allocation function and measures the time spent in it.
+// Used as the Lua allocator directly (default allocator case), or as LuaAlloc's system allocator.
+struct Timed
+{
+    lua_Alloc inner;
+    void *ud;
+    Clock::duration spent;
+    size_t calls;
+
+    // LuaAlloc only: track the peak block count via the metrics area
+    LuaAllocMetrics *metrics;
+    unsigned long long peakblocks;
+};
+
+static void *plainalloc(void *, void *ptr, size_t, size_t nsize)
+{
+    if(nsize)
+        return realloc(ptr, nsize);
+    free(ptr);
+    return NULL;
+}
+
+static void *timedalloc(void *ud, void *ptr, size_t osize, size_t nsize)
+{
+    Timed *t = (Timed*)ud;
+    ++t->calls;
+    const Clock::time_point start = Clock::now();
+    void *ret = t->inner(t->ud, ptr, osize, nsize);
+    t->spent += Clock::now() - start;
+    return ret;
+}
+
+static void sampleblocks(Timed *t)
+{
+    unsigned long long n = 0;
+    for(unsigned i = 0; i < t->metrics->nbins; ++i)
+        n += t->metrics->bins[i].blocks;
+    if(t->peakblocks < n)
+        t->peakblocks = n;
+}
+
+// LuaAlloc's system allocator. The block count only goes up after a block allocation returned,
+// and only goes down by freeing a block, which passes through here as well.
+// So sampling on every call sees the peak.
+static void *samplingsysalloc(void *ud, void *ptr, size_t osize, size_t nsize)
+{
+    Timed *t = (Timed*)ud;
+    sampleblocks(t);
+    return plainalloc(NULL, ptr, osize, nsize);
+}
+
+struct Result
+{
+    double wall, alloc;
+    size_t calls;
+    int ret;
+};
+
+static Result run(const char *fn, lua_Alloc alloc, void *ud, Timed& t)
+{
+    const char *argv[] = { "", fn };
+    t.spent = Clock::duration::zero();
+    t.calls = 0;
+    const Clock::time_point start = Clock::now();
+    Result r;
+    r.ret = runlua(2, argv, alloc, ud);
+    r.wall = std::chrono::duration<double>(Clock::now() - start).count();
+    r.alloc = std::chrono::duration<double>(t.spent).count();
+    r.calls = t.calls;
+    return r;
+}
+
+static void printresult(const char *what, const Result& r)
+{
+    printf("  %-9s wall: %8.3f s, in allocator: %7.3f s (%5.1f%%), %10u allocator calls%s\n",
+        what, r.wall, r.alloc, 100.0 * r.alloc / r.wall, (unsigned)r.calls, r.ret ? " [FAILED]" : "");
+}
+
+// Prefers luaalloc_getstats(); if stats tracking is disabled, the metrics area has the same numbers
+static void printstats(const LuaAlloc *LA, const LuaAllocMetrics *M)
+{
+    const size_t *alive, *total, *blocks;
+    unsigned step, n = luaalloc_getstats(LA, &alive, &total, &blocks, &step);
+    if(n)
+    {
+        for(unsigned i = 0, a = 1, b = step; i < n-1; ++i, a = b+1, b += step)
+            if(total[i])
+                printf("  %3u..%-3u bytes: %5u blocks, %8u alive, %10u done all-time\n",
+                    a, b, (unsigned)blocks[i], (unsigned)alive[i], (unsigned)total[i]);
+        printf("  large:          %8u alive, %10u done all-time\n", (unsigned)alive[n-1], (unsigned)total[n-1]);
+    }
+    else if(M)
+    {
+        n = M->nbins;
+        for(unsigned i = 0, a = 1, b = M->binstep; i < n-1; ++i, a = b+1, b += M->binstep)
+            if(M->bins[i].total)
+                printf("  %3u..%-3u bytes: %5u blocks, %8u alive, %10u done all-time\n",
+                    a, b, (unsigned)M->bins[i].blocks, (unsigned)M->bins[i].alive, (unsigned)M->bins[i].total);
+        printf("  large:          %8u alive, %10u done all-time\n", (unsigned)M->bins[n-1].alive, (unsigned)M->bins[n-1].total);
+    }
+}
+
+static int bench(const char *fn)
+{
+    printf("[%s]\n", fn);
+
+    Timed plain = { plainalloc, NULL, Clock::duration::zero(), 0, NULL, 0 };
+    const Result rp = run(fn, timedalloc, &plain, plain);
+
+    std::vector<unsigned long long> mbuf(luaalloc_metricssize() / sizeof(unsigned long long) + 1);
+    Timed la = { luaalloc, NULL, Clock::duration::zero(), 0, (LuaAllocMetrics*)&mbuf[0], 0 };
+    LuaAlloc *LA = luaalloc_create(samplingsysalloc, &la);
+    la.ud = LA;
+    const bool havemetrics = !!luaalloc_setmetrics(LA, &mbuf[0], mbuf.size() * sizeof(mbuf[0]));
+    const Result rl = run(fn, timedalloc, &la, la);
+    if(havemetrics)
+        sampleblocks(&la);
+
+    printresult("default", rp);
+    printresult("LuaAlloc", rl);
+    printf("  speedup: %.2fx wall, %.2fx allocator\n", rp.wall / rl.wall, rp.alloc / rl.alloc);
+    if(havemetrics)
+        printf("  peak block count: %u\n", (unsigned)la.peakblocks);
+    printstats(LA, havemetrics ? la.metrics : NULL);
+
+    luaalloc_setmetrics(LA, NULL, 0);
+    luaalloc_delete(LA);
+    return rp.ret | rl.ret;
+}
+
+int main(int argc, char **argv)
+{
+    int ret = 0;
+    if(argc > 1)
+        for(int i = 1; i < argc; ++i)
+            ret |= bench(argv[i]);
+    else
+        for(const char **fn = defaultWorkloads; *fn; ++fn)
+            ret |= bench(*fn);
+    return ret;
+}
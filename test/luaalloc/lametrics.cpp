@@ -0,0 +1,127 @@
+// Sidecar tool: Sample live LuaAlloc metrics areas of other processes.
+// Processes publish their metrics via luaalloc_setmetrics() into a shared memory file,
+// e.g. testluaalloc uses /dev/shm/luaalloc-<pid>. Then run:
+//   ./lametrics /dev/shm/luaalloc-*          (print once)
+//   ./lametrics -i 500 /dev/shm/luaalloc-*   (print every 500 ms until killed)
+
+#include "luaalloc.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+struct Source
+{
+    const char *fn;
+    const void *mem;
+    size_t size;
+};
+
+static bool openSource(Source& src, const char *fn)
+{
+    src.fn = fn;
+    src.mem = NULL;
+    int fd = open(fn, O_RDONLY);
+    if(fd < 0)
+        return false;
+    struct stat st;
+    if(!fstat(fd, &st) && (size_t)st.st_size >= sizeof(LuaAllocMetrics))
+    {
+        void *p = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if(p != MAP_FAILED)
+        {
+            src.mem = p;
+            src.size = st.st_size;
+        }
+    }
+    close(fd);
+    return !!src.mem;
+}
+
+static void printSource(const Source& src, LuaAllocMetrics *M, size_t msize)
+{
+    const unsigned n = luaalloc_readmetrics(src.mem, src.size, M, msize);
+    if(!n)
+    {
+        printf("[%s] not a LuaAlloc metrics area, or not responding\n", src.fn);
+        return;
+    }
+
+    unsigned long long alive = 0, blocks = 0, bytes = M->internalbytes, sys = M->internalsysallocs;
+    for(unsigned i = 0; i < n; ++i)
+    {
+        alive += M->bins[i].alive;
+        blocks += M->bins[i].blocks;
+        bytes += M->bins[i].bytes;
+        sys += M->bins[i].sysallocs;
+    }
+    printf("[%s] %llu allocations alive, %llu blocks, %llu KB reserved, %llu sysalloc calls\n",
+        src.fn, alive, blocks, bytes / 1024, sys);
+
+    for(unsigned i = 0, a = 1, b = M->binstep; i < n; ++i, a = b+1, b += M->binstep)
+    {
+        const LuaAllocBinMetrics& m = M->bins[i];
+        if(!m.total && !m.bytes)
+            continue;
+        if(i < n-1)
+            printf("  %4u..%-4u", a, b);
+        else
+            printf("  large    ");
+        printf(" alive: %10llu  total: %12llu  blocks: %6llu  bytes: %10llu  sysallocs: %8llu\n",
+            m.alive, m.total, m.blocks, m.bytes, m.sysallocs);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    unsigned interval = 0;
+    int first = 1;
+    if(argc > 2 && !strcmp(argv[1], "-i"))
+    {
+        interval = atoi(argv[2]);
+        first = 3;
+    }
+    if(first >= argc)
+    {
+        printf("Usage: %s [-i ms] metricsfile...\n", argv[0]);
+        return 2;
+    }
+
+    std::vector<Source> sources;
+    for(int i = first; i < argc; ++i)
+    {
+        Source src;
+        if(openSource(src, argv[i]))
+            sources.push_back(src);
+        else
+            printf("[%s] failed to open\n", argv[i]);
+    }
+
+    // Room for any bin count a metrics area could report
+    size_t msize = 0;
+    for(size_t i = 0; i < sources.size(); ++i)
+        if(msize < sources[i].size)
+            msize = sources[i].size;
+    LuaAllocMetrics *M = (LuaAllocMetrics*)malloc(msize ? msize : 1);
+
+    do
+    {
+        for(size_t i = 0; i < sources.size(); ++i)
+            printSource(sources[i], M, msize);
+        if(interval)
+        {
+            usleep(interval * 1000);
+            puts("");
+        }
+    }
+    while(interval);
+
+    free(M);
+    return sources.empty();
+}
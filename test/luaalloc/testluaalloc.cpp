@@ -1,15 +1,265 @@
 #include "luaalloc.h"
+#include "luaalloc.hh"
+#include "luaalloc_arena.h"
 
-typedef struct lua_Alloc lua_Alloc;
-extern "C" int runlua(int argc, const char*const*argv, void *alloc, void *ud);
+typedef void *(*lua_Alloc)(void *ud, void *ptr, size_t osize, size_t nsize);
+extern "C" int runlua(int argc, const char*const*argv, lua_Alloc alloc, void *ud);
 
 #include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <vector>
+#include <map>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+struct HostObj
+{
+    HostObj() : id(0), ref(0) {}
+    unsigned id;
+    void *ref;
+};
+
+// Returns 0 if objects and containers made with the C++ adaptor hold what was put there
+static int testcpp(LuaAlloc *LA)
+{
+    int bad = 0;
+    std::vector<HostObj*> objs;
+    for(unsigned i = 0; i < 10000; ++i)
+    {
+        HostObj *o = LuaAllocCpp::alloc<HostObj>(LA);
+        if(!o || o->id)
+        {
+            printf("C++ alloc failed!\n");
+            bad = 1;
+            break;
+        }
+        o->id = i;
+        objs.push_back(o);
+    }
+
+    typedef LuaAllocCpp::Allocator<std::pair<const unsigned, HostObj*> > MapAlloc;
+    typedef std::map<unsigned, HostObj*, std::less<unsigned>, MapAlloc> ObjMap;
+    ObjMap m((std::less<unsigned>()), MapAlloc(LA));
+    std::vector<unsigned, LuaAllocCpp::Allocator<unsigned> > v((LuaAllocCpp::Allocator<unsigned>(LA)));
+    for(size_t i = 0; i < objs.size(); ++i)
+    {
+        m[objs[i]->id] = objs[i];
+        v.push_back(objs[i]->id);
+    }
+    if(m.size() != objs.size() || v.size() != objs.size())
+        bad = 1;
+    for(size_t i = 0; i < v.size(); ++i)
+    {
+        ObjMap::const_iterator it = m.find(v[i]);
+        if(it == m.end() || !it->second || it->second->id != v[i])
+            bad = 1;
+    }
+    if(bad)
+        printf("C++ containers corrupted!\n");
+
+    for(size_t i = 0; i < objs.size(); ++i)
+        LuaAllocCpp::free(LA, objs[i]);
+    return bad;
+}
+
+struct ListNode
+{
+    ListNode *next;
+    size_t val;
+    char *str; // large allocation
+};
+
+static ListNode *buildlist(LuaAlloc *LA, size_t n)
+{
+    ListNode *head = NULL;
+    for(size_t i = 0; i < n; ++i)
+    {
+        ListNode *ln = (ListNode*)luaalloc(LA, NULL, 0, sizeof(ListNode));
+        ln->next = head;
+        ln->val = i;
+        ln->str = (i % 1024) ? NULL : (char*)luaalloc(LA, NULL, 0, 1000 + i);
+        if(ln->str)
+            sprintf(ln->str, "str%zu", i);
+        head = ln;
+    }
+    return head;
+}
+
+// Frees the list; returns 0 if it still holds what buildlist() put there
+static int checkfreelist(LuaAlloc *LA, ListNode *head, size_t n)
+{
+    char buf[32];
+    int bad = 0;
+    while(head)
+    {
+        ListNode *next = head->next;
+        if(!n || head->val != --n)
+            bad = 1;
+        if(head->str)
+        {
+            sprintf(buf, "str%zu", head->val);
+            if(strcmp(head->str, buf))
+                bad = 1;
+            luaalloc(LA, head->str, 1000 + head->val, 0);
+        }
+        luaalloc(LA, head, sizeof(ListNode), 0);
+        head = next;
+    }
+    if(bad || n)
+    {
+        puts("Arena list corrupted!");
+        return 1;
+    }
+    return 0;
+}
+
+static int testarena()
+{
+    const char *fn = "testarena.img";
+    const size_t N = 50000;
+    LuaAllocArena *A = luaalloc_arena_create(NULL, (size_t)1 << 30);
+    if(!A)
+    {
+        puts("Arena not supported, skipped");
+        return 0;
+    }
+    luaalloc_arena_setroot(A, buildlist(luaalloc_arena_getalloc(A), N));
+    const int saved = luaalloc_arena_save(A, fn);
+    printf("Arena image: %zu bytes\n", luaalloc_arena_used(A));
+    luaalloc_arena_delete(A);
+    if(!saved)
+    {
+        puts("Failed to save arena image!");
+        return 1;
+    }
+
+    A = luaalloc_arena_load(fn);
+    remove(fn);
+    if(!A)
+    {
+        puts("Failed to load arena image!");
+        return 1;
+    }
+    LuaAlloc *LA = luaalloc_arena_getalloc(A);
+    int ret = checkfreelist(LA, buildlist(LA, N), N); // continue allocating in the restored heap
+    ret |= checkfreelist(LA, (ListNode*)luaalloc_arena_getroot(A), N);
+    luaalloc_arena_delete(A);
+    return ret;
+}
+
+// Publish metrics in shared memory, so that lametrics can watch while the test is running
+static void *publishmetrics(LuaAlloc *LA, char *fn)
+{
+    const size_t sz = luaalloc_metricssize();
+    void *mem = NULL;
+#ifdef __linux__
+    sprintf(fn, "/dev/shm/luaalloc-%d", (int)getpid());
+    int fd = open(fn, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if(fd >= 0)
+    {
+        if(!ftruncate(fd, sz))
+        {
+            mem = mmap(NULL, sz, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if(mem == MAP_FAILED)
+                mem = NULL;
+        }
+        close(fd);
+    }
+    if(!mem)
+        unlink(fn);
+#endif
+    if(!mem)
+    {
+        *fn = 0;
+        mem = malloc(sz);
+    }
+    int ok = luaalloc_setmetrics(LA, mem, sz);
+    if(ok)
+        printf("Metrics published to [%s]\n", *fn ? fn : "(local memory)");
+    return mem;
+}
+
+// The reader must not trust an area: it may be cut short, or its writer may have died in the middle of an update
+static int testreadmetrics()
+{
+    const size_t sz = luaalloc_metricssize();
+    std::vector<unsigned long long> area(sz / sizeof(unsigned long long) + 1), buf(area.size());
+    LuaAllocMetrics *A = (LuaAllocMetrics*)&area[0];
+    LuaAllocMetrics *M = (LuaAllocMetrics*)&buf[0];
+    LuaAlloc *LA = luaalloc_create(0, 0);
+    const int ok = luaalloc_setmetrics(LA, A, sz);
+    luaalloc_setmetrics(LA, NULL, 0);
+    luaalloc_delete(LA);
+    if(!ok)
+    {
+        printf("Metrics export not compiled in! (define LA_ENABLE_METRICS)\n");
+        return 1;
+    }
+    int bad = !luaalloc_readmetrics(A, sz, M, sz);
+    bad |= !!luaalloc_readmetrics(A, sz - sizeof(LuaAllocBinMetrics), M, sz);
+    A->seq |= 1;
+    bad |= !!luaalloc_readmetrics(A, sz, M, sz);
+    if(bad)
+        printf("Metrics reader trusted a broken area!\n");
+    return bad;
+}
+
+// Returns 0 if the metrics area matches luaalloc_getstats(); detaches and frees the area
+static int checkmetrics(LuaAlloc *LA, void *mem, const char *fn)
+{
+    std::vector<unsigned long long> buf(luaalloc_metricssize() / sizeof(unsigned long long) + 1);
+    LuaAllocMetrics *M = (LuaAllocMetrics*)&buf[0];
+    const unsigned n = mem ? luaalloc_readmetrics(mem, luaalloc_metricssize(), M, buf.size() * sizeof(buf[0])) : 0;
+    const size_t *alive, *total, *blocks;
+    const unsigned nstats = luaalloc_getstats(LA, &alive, &total, &blocks, NULL);
+    int bad = 0;
+    if(!n || n != nstats)
+    {
+        printf("Metrics unavailable! (%u bins, %u in stats)\n", n, nstats);
+        bad = 1;
+    }
+    else
+        for(unsigned i = 0; i < n; ++i)
+        {
+            const LuaAllocBinMetrics& b = M->bins[i];
+            if(b.alive != alive[i] || b.total != total[i] || b.blocks != blocks[i] || !(b.blocks || !b.bytes || i == n-1))
+            {
+                printf("Metrics differ from stats in bin %u!\n", i);
+                bad = 1;
+            }
+        }
+
+    luaalloc_setmetrics(LA, NULL, 0);
+#ifdef __linux__
+    if(*fn)
+    {
+        munmap(mem, luaalloc_metricssize());
+        unlink(fn);
+        return bad;
+    }
+#endif
+    free(mem);
+    return bad;
+}
 
 int main()
 {
+    if(testarena() || testreadmetrics())
+        return 1;
+
     LuaAlloc *LA = luaalloc_create(0, 0);
+    char metricsfn[64];
+    void *metrics = publishmetrics(LA, metricsfn);
+    const int cppbad = testcpp(LA);
     const char *fn[] = { "", "test.lua" };
     int ret = runlua(2, fn, luaalloc, LA);
+    const int metricsbad = checkmetrics(LA, metrics, metricsfn);
 
     const size_t *alive, *total, *blocks;
     unsigned step, n = luaalloc_getstats(LA, &alive, &total, &blocks, &step);
@@ -21,4 +271,5 @@ int main()
         printf("large allocations: %zu alive, %zu done all-time\n", alive[n-1], total[n-1]);
     }
     luaalloc_delete(LA);
+    return (cppbad || metricsbad) ? 1 : ret;
 }